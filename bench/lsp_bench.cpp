@@ -0,0 +1,442 @@
+// Microbenchmarks of the server's hot paths on synthetic Swirl sources from
+// 1 KB to 50 MB. Results go to stdout as JSON so runs can be diffed and
+// tracked over time.
+//
+//   swirl_lsp_bench [--filter <substring>] [--max-size <bytes>]
+#include "Analysis.h"
+#include "CompletionSession.h"
+#include "DocumentStore.h"
+#include "JsonWriter.h"
+#include "Lexer.h"
+#include "LineIndex.h"
+#include "LintEngine.h"
+#include "MessageDecoder.h"
+#include "MessageReader.h"
+#include "MessageWriter.h"
+#include "Parser.h"
+#include "ProtocolCodec.h"
+#include "Rope.h"
+#include "json.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using json = nlohmann::json;
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+    using lsp::LineIndex;
+    using lsp::Rope;
+
+    // Keeps results alive so the optimizer can't drop the measured work
+    std::atomic<size_t> sink{0};
+
+    // Stop repeating a case after this long, once it ran MIN_ITERATIONS
+    constexpr auto TIME_BUDGET = std::chrono::milliseconds(300);
+    constexpr int MIN_ITERATIONS = 3;
+    constexpr int MAX_ITERATIONS = 1000;
+
+    // Lookups per iteration for the position benchmarks
+    constexpr size_t LOOKUPS = 10000;
+    // Messages per iteration for the small-message framing benchmarks
+    constexpr size_t MESSAGES = 10000;
+    // Distinct names in the completion benchmark document
+    constexpr size_t COMPLETION_SYMBOLS = 20000;
+
+    const size_t SIZES[] = {1u << 10, 64u << 10, 1u << 20, 10u << 20,
+                            50u << 20};
+
+    std::string makeSource(size_t size) {
+        static const char* const BLOCK =
+            "import std.io\n"
+            "// Adds two numbers and clamps the result\n"
+            "fn add(a: i32, b: i32) -> i32 {\n"
+            "    var total = a + b * 42\n"
+            "    if total >= 10 && total != 99 {\n"
+            "        return total\n"
+            "    }\n"
+            "    const name = \"swirl \\\"lexer\\\"\"\n"
+            "    /* block\n"
+            "       comment */\n"
+            "    return total\n"
+            "}\n"
+            "import\n"
+            "\n";
+        std::string source;
+        source.reserve(size + 512);
+        while (source.size() < size) {
+            source += BLOCK;
+        }
+        source.resize(size);
+        return source;
+    }
+
+    std::string frame(const std::string& body) {
+        return "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" +
+               body;
+    }
+
+    // Unlinked temporary file holding `data`, for the reader benchmarks
+    int makeInputFile(const std::string& data) {
+        std::FILE* file = std::tmpfile();
+        int fd = ::dup(fileno(file));
+        std::fclose(file);
+        size_t written = 0;
+        while (written < data.size()) {
+            ssize_t n = ::write(fd, data.data() + written,
+                                data.size() - written);
+            if (n <= 0) {
+                break;
+            }
+            written += static_cast<size_t>(n);
+        }
+        return fd;
+    }
+
+    class Runner {
+      public:
+        Runner(std::string filter) : filter(std::move(filter)) {}
+
+        // Times `body` repeatedly. `bytes` is the input size the case
+        // works on (0 if it doesn't scale with one) and `ops` how many
+        // operations one call of `body` performs.
+        template <typename F>
+        void run(const std::string& name, size_t bytes, size_t ops, F&& body) {
+            if (!filter.empty() && name.find(filter) == std::string::npos) {
+                return;
+            }
+
+            double best = 0, total = 0;
+            int iterations = 0;
+            auto started = Clock::now();
+            while (iterations < MIN_ITERATIONS ||
+                   (iterations < MAX_ITERATIONS &&
+                    Clock::now() - started < TIME_BUDGET)) {
+                auto start = Clock::now();
+                body();
+                double ns = std::chrono::duration<double, std::nano>(
+                                Clock::now() - start)
+                                .count();
+                best = iterations == 0 ? ns : std::min(best, ns);
+                total += ns;
+                ++iterations;
+            }
+
+            json result = {{"name", name},
+                           {"inputBytes", bytes},
+                           {"iterations", iterations},
+                           {"opsPerIteration", ops},
+                           {"bestNsPerOp", best / ops},
+                           {"meanNsPerOp", total / iterations / ops}};
+            if (bytes > 0) {
+                result["mbPerSec"] = bytes / 1e6 / (best / 1e9);
+            }
+            std::cerr << name << " " << bytes << ": " << best / ops
+                      << " ns/op" << std::endl;
+            results.push_back(std::move(result));
+        }
+
+        json report() const {
+            return {{"benchmarks", results}};
+        }
+
+      private:
+        std::string filter;
+        json results = json::array();
+    };
+
+    void benchDocument(Runner& runner, size_t size) {
+        std::string source = makeSource(size);
+        Rope rope(source);
+        LineIndex lines(source);
+        auto tokens = lsp::lexTokens(rope);
+        lsp::DocumentSnapshot snapshot{"file:///bench.swirl", 1, rope, lines,
+                                       tokens,
+                                       lsp::parseSyntax(rope, *tokens)};
+
+        std::mt19937_64 random(size);
+        std::vector<std::pair<int, int>> positions(LOOKUPS);
+        std::vector<size_t> offsets(LOOKUPS);
+        for (size_t i = 0; i < LOOKUPS; ++i) {
+            positions[i] = {
+                static_cast<int>(random() % lines.lineCount()),
+                static_cast<int>(random() % 48)};
+            offsets[i] = random() % (source.size() + 1);
+        }
+
+        runner.run("tokenize", size, 1, [&] {
+            sink += lsp::tokenize(source).size();
+        });
+        runner.run("rope/build", size, 1, [&] {
+            sink += Rope(source).size();
+        });
+        runner.run("lineIndex/build", size, 1, [&] {
+            sink += LineIndex(source).lineCount();
+        });
+        runner.run("positionToOffset", size, LOOKUPS, [&] {
+            for (auto [line, character] : positions) {
+                sink += lines.offsetAt(rope, line, character);
+            }
+        });
+        runner.run("calculatePosition", size, LOOKUPS, [&] {
+            for (size_t offset : offsets) {
+                sink += lsp::calculatePosition(source, lines, offset).second;
+            }
+        });
+        runner.run("getWordAt", size, LOOKUPS, [&] {
+            for (auto [line, character] : positions) {
+                sink += lsp::getWordAt(rope, lines, line, character).size();
+            }
+        });
+        runner.run("lex/full", size, 1, [&] {
+            sink += lsp::lexTokens(rope)->size();
+        });
+        runner.run("parse/full", size, 1, [&] {
+            sink += lsp::parseSyntax(rope, *tokens)->chunks().size();
+        });
+        // One character typed in the middle of the document, then removed
+        // again so every iteration edits the same text
+        size_t middle = source.find('\n', source.size() / 2);
+        if (middle != std::string::npos) {
+            Rope typed = rope.replace(middle, 0, "x");
+            lsp::EditSpan insert{middle, middle, middle + 1};
+            lsp::EditSpan erase{middle, middle + 1, middle};
+            // A new version's line index: a copy of the previous one, then
+            // the edit
+            runner.run("lineIndex/keystroke", size, 2, [&] {
+                LineIndex next = lines;
+                next.applyEdit(middle, 0, "\n");
+                next.applyEdit(middle, 1, "");
+                sink += next.lineCount();
+            });
+            runner.run("lex/keystroke", size, 2, [&] {
+                auto next = lsp::relexTokens(*tokens, typed, insert);
+                sink += lsp::relexTokens(*next, rope, erase)->size();
+            });
+            auto typedTokens = lsp::relexTokens(*tokens, typed, insert);
+            runner.run("parse/keystroke", size, 2, [&] {
+                auto next = lsp::reparseSyntax(*snapshot.syntax, typed,
+                                               *typedTokens, insert);
+                sink += lsp::reparseSyntax(*next, rope, *tokens, erase)
+                            ->chunks()
+                            .size();
+            });
+        }
+        // All lint rules in their single pass over the tokens
+        runner.run("lint/run", size, 1, [&] {
+            std::atomic<bool> cancelled{false};
+            lsp::lintEngine().run(*tokens, cancelled,
+                                  [&](size_t rule, size_t, size_t) {
+                                      sink += rule;
+                                  });
+        });
+        runner.run("validateDocument", size, 1, [&] {
+            std::atomic<bool> cancelled{false};
+            sink += lsp::computeDiagnostics(snapshot, cancelled)->size();
+        });
+        // Document text as one JSON string: mostly the escape scan
+        runner.run("json/writeText", size, 1, [&] {
+            lsp::JsonWriter out(size + size / 8);
+            out.value(source);
+            sink += out.finishFrame();
+        });
+
+        // A didOpen carrying the whole file, as the client sends it
+        std::string body =
+            json{{"jsonrpc", "2.0"},
+                 {"method", "textDocument/didOpen"},
+                 {"params",
+                  {{"textDocument",
+                    {{"uri", snapshot.uri},
+                     {"languageId", "swirl"},
+                     {"version", 1},
+                     {"text", source}}}}}}
+                .dump();
+        int fd = makeInputFile(frame(body));
+        runner.run("framing/readDidOpen", body.size(), 1, [&] {
+            ::lseek(fd, 0, SEEK_SET);
+            lsp::MessageReader reader(fd);
+            while (auto message = reader.next()) {
+                sink += message->size();
+            }
+        });
+        ::close(fd);
+        runner.run("json/parseDidOpen", body.size(), 1, [&] {
+            // DOM parse plus the copy the handler used to make
+            json message = json::parse(body);
+            sink += message["params"]["textDocument"]["text"]
+                        .get<std::string>()
+                        .size();
+        });
+        // As the server does it: into a recycled per-request arena
+        lsp::Arena arena;
+        runner.run("json/decodeDidOpen", body.size(), 1, [&] {
+            lsp::Envelope envelope;
+            lsp::DidOpenTextDocumentParams params;
+            lsp::scanEnvelope(body, envelope);
+            lsp::decodeJson(envelope.params, params, arena);
+            sink += params.textDocument.text.size();
+            arena.reset();
+        });
+    }
+
+    void benchCompletion(Runner& runner) {
+        // A document declaring many distinct names, typed into at its end
+        std::string source;
+        for (size_t i = 0; i < COMPLETION_SYMBOLS; ++i) {
+            source += "var symbol" + std::to_string(i) + "_value = " +
+                      std::to_string(i) + "\n";
+        }
+        std::string_view typed = "sym12val";
+        source += typed;
+        Rope rope(source);
+        LineIndex lines(source);
+        auto tokens = lsp::lexTokens(rope);
+        lsp::DocumentSnapshot snapshot{"file:///bench.swirl", 1, rope, lines,
+                                       tokens,
+                                       lsp::parseSyntax(rope, *tokens)};
+        int line = static_cast<int>(lines.lineCount() - 1);
+
+        runner.run("completion/startSession", source.size(), 1, [&] {
+            lsp::CompletionSessions sessions;
+            sink += sessions.complete(&snapshot, {line, 3}).entries.size();
+        });
+        // One keystroke per op: the prefix grows within one session, then
+        // starts over
+        lsp::CompletionSessions sessions;
+        runner.run("completion/refine", source.size(), typed.size(), [&] {
+            for (size_t i = 1; i <= typed.size(); ++i) {
+                sink += sessions.complete(&snapshot,
+                                          {line, static_cast<int>(i)})
+                            .entries.size();
+            }
+        });
+    }
+
+    void benchMessages(Runner& runner) {
+        std::string_view line = "let total = he";
+        lsp::DocumentSnapshot snapshot{.uri = "file:///bench.swirl",
+                                       .version = 1,
+                                       .text = lsp::Rope(line),
+                                       .lines = lsp::LineIndex(line)};
+        lsp::Position cursor{0, static_cast<int>(line.size())};
+        lsp::CompletionSessions sessions;
+        runner.run("completion/serialize", 0, 1, [&] {
+            lsp::JsonWriter out;
+            out.beginObject();
+            out.field("jsonrpc", "2.0");
+            out.field("id", 1);
+            out.key("result");
+            lsp::writeJson(out, sessions.complete(&snapshot, cursor));
+            out.endObject();
+            sink += out.finishFrame();
+        });
+        // The same items encoded field by field on every request
+        const lsp::CompletionCache& items = lsp::completionItems();
+        runner.run("completion/serializeUncached", 0, 1, [&] {
+            lsp::JsonWriter out;
+            out.beginObject();
+            out.field("jsonrpc", "2.0");
+            out.field("id", 1);
+            out.key("result");
+            out.beginObject();
+            out.field("isIncomplete", false);
+            out.key("items");
+            out.beginArray();
+            for (lsp::CompletionCache::ItemId id = 0; id < items.size(); ++id) {
+                out.beginObject();
+                out.field("label", items.label(id));
+                out.field("kind", 1);
+                out.field("detail", "swirl C++ lsp server");
+                out.field("documentation",
+                          "Function completion from swirl LSP server");
+                out.field("sortText", "0001");
+                out.key("textEdit");
+                out.beginObject();
+                out.key("range");
+                lsp::writeJson(out, lsp::Range{{0, 12}, {0, 14}});
+                out.field("newText", items.label(id));
+                out.endObject();
+                out.endObject();
+            }
+            out.endArray();
+            out.endObject();
+            out.endObject();
+            sink += out.finishFrame();
+        });
+
+        std::string hover =
+            json{{"jsonrpc", "2.0"},
+                 {"id", 1},
+                 {"method", "textDocument/hover"},
+                 {"params",
+                  {{"textDocument", {{"uri", "file:///bench.swirl"}}},
+                   {"position", {{"line", 12}, {"character", 4}}}}}}
+                .dump();
+        std::string stream;
+        for (size_t i = 0; i < MESSAGES; ++i) {
+            stream += frame(hover);
+        }
+        int fd = makeInputFile(stream);
+        runner.run("framing/readSmall", stream.size(), MESSAGES, [&] {
+            ::lseek(fd, 0, SEEK_SET);
+            lsp::MessageReader reader(fd);
+            while (auto message = reader.next()) {
+                sink += message->size();
+            }
+        });
+        ::close(fd);
+
+        lsp::JsonWriter completionWriter;
+        lsp::writeJson(completionWriter, sessions.complete(nullptr, {}));
+        std::string completion(completionWriter.body());
+        int devNull = ::open("/dev/null", O_WRONLY);
+        runner.run("framing/writeSmall", completion.size() * MESSAGES,
+                   MESSAGES, [&] {
+                       lsp::MessageWriter writer(devNull);
+                       for (size_t i = 0; i < MESSAGES; ++i) {
+                           writer.send(completion);
+                       }
+                       writer.close();
+                       sink += writer.bytesWritten();
+                   });
+        ::close(devNull);
+    }
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string filter;
+    size_t maxSize = SIZE_MAX;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (std::strcmp(argv[i], "--max-size") == 0 && i + 1 < argc) {
+            maxSize = std::stoull(argv[++i]);
+        } else {
+            std::cerr << "usage: " << argv[0]
+                      << " [--filter <substring>] [--max-size <bytes>]"
+                      << std::endl;
+            return 2;
+        }
+    }
+
+    Runner runner(filter);
+    benchMessages(runner);
+    benchCompletion(runner);
+    for (size_t size : SIZES) {
+        if (size <= maxSize) {
+            benchDocument(runner, size);
+        }
+    }
+
+    std::cout << runner.report().dump(2) << std::endl;
+    return 0;
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include "CompletionCache.h"
+#include "DocumentStore.h"
+#include "LineIndex.h"
+#include "LintEngine.h"
+#include "Protocol.h"
+#include "Rope.h"
+#include "SyntaxTree.h"
+#include "TokenList.h"
+#include <memory>
+#include <atomic>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace lsp {
+
+    // Language features behind the handlers, kept free of the transport so
+    // they can be driven directly by the benchmarks.
+
+    // Word (alphanumeric run) touching the given position
+    std::string getWordAt(const Rope& content, const LineIndex& lines,
+                          int line, int character);
+
+    // The document's tokens and syntax tree, computed here if the snapshot
+    // has none
+    std::shared_ptr<const TokenList>
+    tokenList(const DocumentSnapshot& document);
+    std::shared_ptr<const SyntaxTree>
+    syntaxTree(const DocumentSnapshot& document);
+
+    // Text of a node
+    std::string nodeText(const DocumentSnapshot& document, SyntaxNode node);
+
+    // Markdown for textDocument/hover: the declaration of the name under
+    // the cursor, if the document has one
+    std::string hoverText(const DocumentSnapshot& document,
+                          Position position);
+
+    // Line and UTF-16 character of a byte offset
+    std::pair<int, int> calculatePosition(std::string_view content,
+                                          const LineIndex& lines,
+                                          size_t offset);
+    std::pair<int, int> calculatePosition(const Rope& content,
+                                          const LineIndex& lines,
+                                          size_t offset);
+
+    // The diagnostics array for one snapshot: its syntax errors and what
+    // the lint rules report, with the severities in `settings` (the
+    // rules' defaults when null). std::nullopt if `cancelled` was raised
+    // before it was complete.
+    std::optional<std::vector<Diagnostic>>
+    computeDiagnostics(const DocumentSnapshot& document,
+                       const std::atomic<bool>& cancelled,
+                       const LintSettings* settings = nullptr);
+
+    // Items offered by textDocument/completion, encoded once on first use
+    const CompletionCache& completionItems();
+
+    // The word characters in front of a position, which a completion
+    // replaces
+    struct WordPrefix {
+        Range range;
+        size_t offset; // byte offset of range.start
+        std::string text;
+    };
+    WordPrefix wordPrefix(const DocumentSnapshot& document,
+                          Position position);
+
+    // Markdown code block with the line declaring `name` at `offset`, where
+    // `offset` is from `version` of the document. If the document has
+    // changed since, `name` must still be found there.
+    std::optional<std::string>
+    renderDeclaration(const DocumentSnapshot& document, int version,
+                      size_t offset, std::string_view name);
+} // namespace lsp
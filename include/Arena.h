@@ -0,0 +1,103 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace lsp {
+
+    // Monotonic bump allocator. Allocation is a pointer increment within
+    // the current chunk; nothing is freed individually, everything goes at
+    // once in reset(). The first chunk is kept across resets, so an arena
+    // that is reused for similar work stops touching the heap altogether.
+    //
+    // Objects placed in an arena are not destroyed by it. Store trivially
+    // destructible data, or destroy objects explicitly before reset().
+    class Arena {
+      public:
+        explicit Arena(size_t firstChunk = 16 * 1024);
+        ~Arena();
+
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+
+        void* allocate(size_t size,
+                       size_t alignment = alignof(std::max_align_t)) {
+            char* p = alignUp(cursor, alignment);
+            if (p > limit || size > static_cast<size_t>(limit - p)) {
+                return allocateSlow(size, alignment);
+            }
+            cursor = p + size;
+            return p;
+        }
+
+        template <typename T> T* allocateArray(size_t count) {
+            return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+        }
+
+        template <typename T, typename... Args> T* create(Args&&... args) {
+            return new (allocate(sizeof(T), alignof(T)))
+                T(std::forward<Args>(args)...);
+        }
+
+        // A copy of `text` that lives as long as the arena's contents
+        std::string_view copy(std::string_view text);
+
+        // Releases every allocation. All but the first chunk go back to
+        // the heap.
+        void reset();
+
+        // Bytes handed out since the last reset, padding included
+        size_t bytesUsed() const;
+
+      private:
+        struct Chunk {
+            Chunk* next;
+            size_t size; // usable bytes after the header
+        };
+
+        Chunk* first = nullptr;
+        Chunk* current = nullptr;
+        char* cursor = nullptr;
+        char* limit = nullptr;
+        size_t retired = 0; // bytes used in chunks before `current`
+
+        static char* alignUp(char* p, size_t alignment) {
+            auto value = reinterpret_cast<uintptr_t>(p);
+            return reinterpret_cast<char*>((value + alignment - 1) &
+                                           ~(alignment - 1));
+        }
+        static char* begin(Chunk* chunk) {
+            return reinterpret_cast<char*>(chunk + 1);
+        }
+
+        void* allocateSlow(size_t size, size_t alignment);
+        void startChunk(Chunk* chunk);
+    };
+
+    // Recycles arenas between requests so their first chunk is reused
+    // instead of reallocated. Thread-safe; arenas are typically acquired on
+    // the reader thread and released by a worker.
+    class ArenaPool {
+      public:
+        explicit ArenaPool(size_t maxIdle = 64) : maxIdle(maxIdle) {}
+        ~ArenaPool();
+
+        ArenaPool(const ArenaPool&) = delete;
+        ArenaPool& operator=(const ArenaPool&) = delete;
+
+        Arena* acquire();
+        // Resets the arena and keeps it for reuse, or frees it if enough
+        // are idle already
+        void release(Arena* arena);
+
+      private:
+        size_t maxIdle;
+        std::mutex mutex;
+        std::vector<Arena*> idle;
+    };
+} // namespace lsp
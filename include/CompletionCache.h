@@ -0,0 +1,108 @@
+#pragma once
+#include "JsonWriter.h"
+#include "Protocol.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace lsp {
+
+    // Completion items encoded to JSON once, when they are registered.
+    // Most items (keywords, library symbols) never change, so a response
+    // copies their encoded members into the frame and only writes what
+    // depends on the request: the sort key, the edit range and the resolve
+    // handle. Only label and kind are sent up front; detail and
+    // documentation are kept for completionItem/resolve.
+    class CompletionCache {
+      public:
+        using ItemId = uint32_t;
+        static constexpr uint32_t NO_DECLARATION = UINT32_MAX;
+
+        // `declaration` is the byte offset of the item's declaration in
+        // the document it was collected from, if any
+        ItemId add(const CompletionItem& item,
+                   uint32_t declaration = NO_DECLARATION);
+
+        size_t size() const {
+            return items.size();
+        }
+        std::string_view label(ItemId id) const {
+            return slice(items[id].label);
+        }
+        // The item's members, "label":...,"kind":... without braces
+        std::string_view members(ItemId id) const {
+            return slice(items[id].members);
+        }
+        // The label as an encoded JSON string, reused as textEdit.newText
+        std::string_view encodedLabel(ItemId id) const {
+            return slice(items[id].encodedLabel);
+        }
+
+        // Resolve-time parts; empty if the item has none
+        std::string_view detail(ItemId id) const {
+            return slice(items[id].detail);
+        }
+        std::string_view documentation(ItemId id) const {
+            return slice(items[id].documentation);
+        }
+        uint32_t declaration(ItemId id) const {
+            return items[id].declaration;
+        }
+
+      private:
+        struct Slice {
+            uint32_t offset;
+            uint32_t length;
+        };
+        struct Item {
+            Slice label;
+            Slice members;
+            Slice encodedLabel;
+            Slice detail;
+            Slice documentation;
+            uint32_t declaration;
+        };
+
+        // All encoded text, back to back
+        std::string storage;
+        std::vector<Item> items;
+        JsonWriter scratch{128};
+
+        std::string_view slice(Slice s) const {
+            return std::string_view(storage).substr(s.offset, s.length);
+        }
+        Slice append(std::string_view text);
+    };
+
+    // One item of a completion result with its per-request parts
+    struct CompletionEntry {
+        const CompletionCache* cache;
+        CompletionCache::ItemId item;
+        uint32_t rank; // sent as a fixed-width sortText
+        // When set, a textEdit replacing this range with the label
+        std::optional<Range> replace;
+    };
+
+    // Result of textDocument/completion, encoded from caches
+    struct CompletionResult {
+        bool isIncomplete = false;
+        std::vector<CompletionEntry> entries;
+        // Sent once as itemDefaults.editRange instead of a textEdit per
+        // item, for clients that support it
+        std::optional<Range> editRange;
+        // Sent in each item's data with the item's index, so resolve can
+        // find it again (see ResolveTable); 0 for none
+        uint64_t handle = 0;
+        // Document version the items' declaration offsets refer to
+        int version = 0;
+        // Keeps caches the entries point into alive until it is sent
+        std::shared_ptr<const void> owner;
+    };
+
+    // Writes `result` as a CompletionList
+    void writeJson(JsonWriter& out, const CompletionResult& result);
+} // namespace lsp
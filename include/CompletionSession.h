@@ -0,0 +1,97 @@
+#pragma once
+#include "CompletionCache.h"
+#include "DocumentStore.h"
+#include "Protocol.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace lsp {
+
+    // Completion sessions, one per document. A session starts where the
+    // word being completed starts and holds the candidate set gathered
+    // there: the static items plus the names the document declares. While
+    // the user keeps typing the same word, follow-up requests only filter
+    // and re-rank those candidates, narrowing the previous matches when the
+    // prefix grows. Results are capped at limit() items and marked
+    // isIncomplete beyond that, so the client asks again as it narrows.
+    class CompletionSessions {
+      public:
+        // `document` may be null, which offers the static items only
+        CompletionResult complete(const DocumentSnapshot* document,
+                                  Position position);
+
+        // Whether results share their edit range through itemDefaults
+        void setDefaultEditRange(bool enabled) {
+            defaultEditRange.store(enabled, std::memory_order_relaxed);
+        }
+
+        void setLimit(size_t limit) {
+            maxItems.store(limit, std::memory_order_relaxed);
+        }
+        size_t limit() const {
+            return maxItems.load(std::memory_order_relaxed);
+        }
+
+        // Drops the session of a closed document
+        void forget(std::string_view uri);
+
+      private:
+        struct Candidate {
+            const CompletionCache* cache;
+            CompletionCache::ItemId item;
+            std::string_view label;
+        };
+
+        struct Session {
+            // Where the completed word starts
+            int line = 0;
+            int character = 0;
+            // Version the symbols were collected from
+            int version = 0;
+            // Byte offset of the word start
+            size_t wordOffset = 0;
+            // Names declared in the document, encoded like the static items
+            CompletionCache symbols;
+            std::vector<Candidate> candidates;
+            std::vector<uint32_t> bags; // charBag() of each candidate label
+
+            // Guards the refinement state below
+            std::mutex mutex;
+            // The latest text the session served and the length of the
+            // word typed in it, to tell whether a later version changed
+            // anything but that word
+            Rope text;
+            size_t wordLength = 0;
+            // Whether `matches` holds the result for `prefix`; it may be
+            // empty when nothing matched
+            bool filtered = false;
+            std::string prefix;
+            std::vector<uint32_t> matches; // candidates matching `prefix`
+        };
+
+        std::atomic<size_t> maxItems{100};
+        std::atomic<bool> defaultEditRange{false};
+        std::mutex mutex;
+        std::unordered_map<std::string, std::shared_ptr<Session>> sessions;
+
+        static std::shared_ptr<Session>
+        startSession(const DocumentSnapshot* document, size_t wordStart,
+                     int line, int character);
+        // Whether `document` differs from the text the session last served
+        // only in the word typed at its start, now `wordLength` bytes long;
+        // if so the session takes it as its latest text
+        static bool onlyWordChanged(Session& session,
+                                    const DocumentSnapshot& document,
+                                    size_t wordLength);
+        CompletionResult rank(const std::shared_ptr<Session>& session,
+                              std::string_view prefix,
+                              const std::optional<Range>& replace);
+    };
+} // namespace lsp
@@ -0,0 +1,71 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+namespace lsp {
+
+    // Debounces and coalesces document validation.
+    //
+    // Every edit reschedules its document `delay` into the future, so a
+    // burst of keystrokes ends in a single validation of the last version.
+    // Scheduling a document that is already being validated raises that
+    // run's cancellation flag, so stale work stops early.
+    class DiagnosticsScheduler {
+      public:
+        using CancelFlag = std::shared_ptr<std::atomic<bool>>;
+        // Starts a validation of `version` of `uri`. Must call finished()
+        // once the validation is over.
+        using Launch = std::function<void(const std::string& uri, int version,
+                                          CancelFlag cancelled)>;
+
+        explicit DiagnosticsScheduler(
+            Launch launch,
+            std::chrono::milliseconds delay = std::chrono::milliseconds(100));
+        ~DiagnosticsScheduler();
+
+        DiagnosticsScheduler(const DiagnosticsScheduler&) = delete;
+        DiagnosticsScheduler& operator=(const DiagnosticsScheduler&) = delete;
+
+        // Requests a validation of `version`, replacing any pending one for
+        // the same document. `immediate` skips the debounce delay.
+        void schedule(const std::string& uri, int version,
+                      bool immediate = false);
+        // Drops pending work for a document and cancels a running one
+        void cancel(const std::string& uri);
+        void finished(const std::string& uri, const CancelFlag& cancelled);
+
+        void setDelay(std::chrono::milliseconds delay);
+
+        // Launches whatever is still pending and stops the timer thread
+        void shutdown();
+
+      private:
+        using Clock = std::chrono::steady_clock;
+
+        struct Pending {
+            Clock::time_point deadline;
+            int version;
+        };
+
+        Launch launch;
+        std::chrono::milliseconds delay;
+
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::unordered_map<std::string, Pending> pending;
+        std::unordered_map<std::string, CancelFlag> running;
+        bool stopping = false;
+        std::thread thread;
+
+        void loop();
+        void start(std::unique_lock<std::mutex>& lock, const std::string& uri,
+                   int version);
+    };
+} // namespace lsp
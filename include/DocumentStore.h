@@ -0,0 +1,80 @@
+#pragma once
+#include "LineIndex.h"
+#include "Protocol.h"
+#include "Rope.h"
+#include "SyntaxTree.h"
+#include "TokenList.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace lsp {
+
+    // One version of an open document. Snapshots are never modified after
+    // they are published, so any number of threads can read one while
+    // newer versions are being produced.
+    struct DocumentSnapshot {
+        std::string uri;
+        int version = 0;
+        Rope text;
+        LineIndex lines;
+        // Tokens and parse of `text`; null only for snapshots built
+        // outside a store
+        std::shared_ptr<const TokenList> tokens = nullptr;
+        std::shared_ptr<const SyntaxTree> syntax = nullptr;
+    };
+
+    using SnapshotPtr = std::shared_ptr<const DocumentSnapshot>;
+
+    // Open documents, each as its latest immutable snapshot. Readers take a
+    // reference-counted handle and never block writers; writers build the
+    // next version from the previous one and publish it atomically. Since
+    // the rope shares structure between versions, a snapshot costs
+    // O(log n) for the text, and line index, tokens and syntax tree are
+    // redone only around the edited text.
+    class DocumentStore {
+      public:
+        SnapshotPtr open(std::string_view uri, std::string_view text,
+                         int version);
+        // Applies `changes` in order and publishes the result as `version`.
+        // Returns null if the document isn't open.
+        SnapshotPtr update(std::string_view uri,
+                           std::span<const TextChange> changes, int version);
+        void close(std::string_view uri);
+
+        // Latest snapshot, or null if the document isn't open
+        SnapshotPtr get(std::string_view uri) const;
+
+      private:
+        struct Entry {
+            std::atomic<SnapshotPtr> current;
+        };
+
+        // Lets lookups by a borrowed URI skip building a std::string
+        struct UriHash {
+            using is_transparent = void;
+            size_t operator()(std::string_view uri) const {
+                return std::hash<std::string_view>{}(uri);
+            }
+        };
+
+        // Guards the shape of the map; snapshots themselves are swapped
+        // through Entry::current without it
+        mutable std::shared_mutex mapMutex;
+        std::unordered_map<std::string, std::unique_ptr<Entry>, UriHash,
+                           std::equal_to<>>
+            entries;
+        // Serializes writers so two edits never start from the same base
+        std::mutex writeMutex;
+
+        Entry* find(std::string_view uri) const;
+    };
+} // namespace lsp
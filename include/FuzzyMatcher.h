@@ -0,0 +1,29 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace lsp {
+
+    // Fuzzy matching of a typed prefix against completion labels, as
+    // editors do it: the pattern's characters must appear in the label in
+    // order, ignoring case.
+
+    // One bit per letter, digit and '_' that occurs in `text`, case folded;
+    // everything else shares bit 31. A label can only match a pattern whose
+    // bag is a subset of its own.
+    uint32_t charBag(std::string_view text);
+
+    // Appends to `out` the index of every bag in `bags` that contains all
+    // of `needed`, four bags per compare
+    void filterByBag(const uint32_t* bags, size_t count, uint32_t needed,
+                     std::vector<uint32_t>& out);
+
+    // Score of `word` for `pattern`, higher is better, or -1 if the pattern
+    // is not a subsequence of the word. Matches at the start of the word or
+    // of its segments (after '_', at a lower to upper case step), runs of
+    // consecutive characters and exact case are rewarded; characters
+    // skipped before the first match cost a little.
+    int fuzzyScore(std::string_view pattern, std::string_view word);
+} // namespace lsp
@@ -0,0 +1,90 @@
+#pragma once
+#include "Arena.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace lsp {
+
+    // Pull parser over a JSON text held in memory. The caller asks for the
+    // value it expects next, so decoding into a struct is a single pass with
+    // no intermediate tree. Every call returns false on a type mismatch or
+    // malformed input, after which the reader stays failed.
+    //
+    //     in.beginObject();
+    //     while (in.nextMember(key)) { ...read or skip the value... }
+    //     if (!in.ok()) ...
+    class JsonReader {
+      public:
+        // Strings read as views are copied into `arena`, so they outlive
+        // the input
+        explicit JsonReader(std::string_view text, Arena* arena = nullptr)
+            : p(text.data()), end(text.data() + text.size()), arena(arena) {}
+
+        bool ok() const {
+            return !failed;
+        }
+        // Where strings and lists read as views are stored; may be null
+        Arena* allocator() const {
+            return arena;
+        }
+        // Fails the reader, for callers that reject a well-formed value
+        bool fail() {
+            failed = true;
+            return false;
+        }
+        // Next significant character, or '\0' at the end of the input
+        char peek();
+
+        bool beginObject();
+        // Advances to the next key of the current object and consumes its
+        // colon. Returns false at the closing brace or on error. The key
+        // stays valid until the next call.
+        bool nextMember(std::string_view& key);
+        bool beginArray();
+        // True while the current array has another element to read
+        bool nextElement();
+
+        bool readString(std::string& out);
+        // Reads a string as a view into the input when it has no escapes,
+        // and unescaped into `storage` otherwise
+        bool readString(std::string_view& out, std::string& storage);
+        // Reads a string into the arena. Fails if there is none.
+        bool readString(std::string_view& out);
+        bool readInteger(int64_t& out);
+        bool readDouble(double& out);
+        bool readBool(bool& out);
+        // Consumes a null if there is one
+        bool readNull();
+
+        // The raw text of the next value, which is skipped over. Only
+        // bracket nesting is checked inside it.
+        bool readRaw(std::string_view& out);
+        bool skipValue();
+
+        // Once the top-level value has been read: only whitespace is left
+        bool atEnd();
+
+      private:
+        const char* p;
+        const char* end;
+        Arena* arena;
+        bool failed = false;
+        // Per container: no element read yet
+        bool first = true;
+        std::string keyStorage;
+
+        void skipSpace();
+        bool expect(char c);
+        // The still escaped contents of the next string
+        bool scanString(std::string_view& body, bool& escaped);
+    };
+
+    // One past the closing quote of the string whose opening quote is at
+    // `p`, or null if it is unterminated. `escaped` tells whether it
+    // contains any backslash.
+    const char* skipJsonString(const char* p, const char* end, bool& escaped);
+
+    // One past the value starting at `p`, or null if it runs off the end
+    const char* skipJsonValue(const char* p, const char* end);
+} // namespace lsp
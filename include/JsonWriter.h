@@ -0,0 +1,100 @@
+#pragma once
+#include "json.hpp"
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+using json = nlohmann::json;
+
+namespace lsp {
+
+    // Streams a JSON message straight into an outbound frame buffer. Space
+    // for the Content-Length header is reserved in front of the body and
+    // filled in by finishFrame(), so the bytes are written once and handed
+    // to the MessageWriter as they are. Keys and values are appended as
+    // they come; there is no intermediate tree.
+    //
+    // Nesting is tracked in a 64-bit mask, which caps it at 63 levels.
+    class JsonWriter {
+      public:
+        explicit JsonWriter(size_t capacity = 512);
+
+        void beginObject();
+        void endObject();
+        void beginArray();
+        void endArray();
+        void key(std::string_view name);
+
+        void value(std::string_view text);
+        void value(const char* text) {
+            value(std::string_view(text));
+        }
+        void value(const std::string& text) {
+            value(std::string_view(text));
+        }
+        void value(bool flag);
+        void value(std::nullptr_t);
+        void value(double number);
+        template <std::integral T> void value(T number) {
+            if constexpr (std::is_signed_v<T>) {
+                writeInteger(static_cast<int64_t>(number));
+            } else {
+                writeUnsigned(static_cast<uint64_t>(number));
+            }
+        }
+        // Fallback for parts that are still DOM values (ids, echoed params)
+        void value(const json& node);
+
+        // A value that is already encoded, copied as is
+        void raw(std::string_view encoded);
+        // Members that are already encoded ("a":1,"b":2), appended to the
+        // current object
+        void rawMembers(std::string_view encoded);
+
+        // key(name) followed by value(v)
+        template <typename T> void field(std::string_view name, const T& v) {
+            key(name);
+            value(v);
+        }
+
+        // The serialized body so far
+        std::string_view body() const {
+            return std::string_view(buffer).substr(HEADER_SPACE);
+        }
+
+        // Writes the Content-Length header right in front of the body and
+        // returns the offset at which the frame starts in the buffer.
+        size_t finishFrame();
+
+        // Starts over with an empty body, keeping the buffer's capacity
+        void clear() {
+            buffer.resize(HEADER_SPACE);
+            hasItems = 0;
+            depth = 0;
+            afterKey = false;
+        }
+
+        // Gives up the buffer, header space included
+        std::string release() {
+            return std::move(buffer);
+        }
+
+      private:
+        // "Content-Length: " + 20 digits + "\r\n\r\n"
+        static constexpr size_t HEADER_SPACE = 40;
+
+        std::string buffer;
+        uint64_t hasItems = 0; // bit n: the container at depth n is non-empty
+        unsigned depth = 0;
+        bool afterKey = false;
+
+        void separate();
+        void begin(char bracket);
+        void end(char bracket);
+        void writeString(std::string_view text);
+        void writeInteger(int64_t number);
+        void writeUnsigned(uint64_t number);
+    };
+} // namespace lsp
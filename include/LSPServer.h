@@ -1,7 +1,28 @@
 #pragma once
+#include "Arena.h"
+#include "CompletionSession.h"
+#include "DiagnosticsScheduler.h"
+#include "DocumentStore.h"
+#include "JsonWriter.h"
+#include "LineIndex.h"
+#include "LintEngine.h"
+#include "MessageWriter.h"
+#include "MethodRegistry.h"
+#include "PublishedDiagnostics.h"
+#include "ResolveTable.h"
+#include "Request.h"
+#include "Scheduler.h"
+#include "SessionTrace.h"
+#include "Stats.h"
 #include "json.hpp"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <span>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <vector>
 
 using json = nlohmann::json;
 
@@ -11,39 +32,120 @@ namespace lsp {
       public:
         Server();
         ~Server();
-        void run();
+        // Serves stdin/stdout until the client closes stdin. With a
+        // recordPath, all traffic is also captured to a session trace.
+        void run(const std::string& recordPath = "");
 
       private:
-        // Document manger: URI: content
-        std::unordered_map<std::string, std::string> documents;
+        friend struct MethodBinder;
+        friend struct MethodRegistry;
+        friend struct ReleaseRequest;
 
-        // Track document version
-        std::unordered_map<std::string, int> document_versions;
+        // Outbound message pipeline to stdout
+        MessageWriter writer;
 
-        void storeDocument(const std::string& uri, const std::string& content,
+        // Document manger: URI: latest snapshot
+        DocumentStore documents;
+
+        // Candidate sets of the words being completed, per document
+        CompletionSessions completions;
+        // Recent completion results, for completionItem/resolve
+        ResolveTable resolveTable;
+        // Severity of each lint rule, from initializationOptions.lint.
+        // Building it compiles the rules, so that happens at startup.
+        LintSettings lintSettings{lintEngine()};
+        // Hash of the diagnostics last sent per document, to skip repeats
+        PublishedDiagnostics published;
+        // Held while diagnostics are published and while a document is
+        // opened or closed, so a validation that finishes as its
+        // document closes can't publish after the close
+        std::mutex publishMutex;
+        // Publish after every validation even if nothing changed, from
+        // initializationOptions.publishUnchangedDiagnostics
+        std::atomic<bool> publishUnchanged{false};
+
+        // Cancellation flags of in-flight requests, keyed by serialized id
+        std::mutex inflightMutex;
+        std::unordered_map<std::string, std::shared_ptr<std::atomic<bool>>>
+            inflight;
+
+        // Per-request arenas holding decoded params, recycled across
+        // requests. Outlives the scheduler, whose tasks release into it.
+        ArenaPool arenas;
+
+        // Session trace of all traffic, when running with --record
+        std::unique_ptr<TraceRecorder> recorder;
+
+        // Latency histograms and traffic counters, see $/swirl/stats
+        ServerStats stats;
+
+        // Worker pool running the handlers. Declared late so it is torn
+        // down before the state its tasks touch.
+        Scheduler scheduler;
+
+        // Debounces validation after edits; launches into the scheduler
+        DiagnosticsScheduler diagnostics;
+
+        void storeDocument(std::string_view uri, std::string_view content,
                            int version = 0);
-        void updateDocument(const std::string& uri,
-                            const std::string& newContent, int version);
-        void removeDocument(const std::string& uri);
-        std::string getDocument(const std::string& uri);
-        bool hasDocument(const std::string& uri);
+        void updateDocument(std::string_view uri,
+                            std::span<const TextChange> changes, int version);
+        void removeDocument(std::string_view uri);
+        SnapshotPtr getDocument(std::string_view uri);
 
         // helper functions
-        void processRequest(const json& request);
         void sendResponse(const json& response);
-        void parseMessage(const std::string& jsonContent);
-
-        // Request handlers
-        void onInitialize(const json& request);
-        void onDidOpen(const json& request);
-        void onDidChangeContent(const json& request);
-        void onCompletion(const json& request);
-        void onCompletionResolve(const json& request);
-        void onHover(const json& request);
-        void onSetTrace(const json& request);
-
-        void validateDocument(const std::string& uri);
-        std::pair<int, int> calculatePosition(const std::string& content,
-                                              size_t offset);
+        void sendError(const json& id, ErrorCode code,
+                       const std::string& message);
+        // Typed results and notifications skip the DOM and are written
+        // straight into their frame
+        template <typename Result>
+        void sendResult(const json& id, const Result& result);
+        template <typename Params>
+        void sendNotification(std::string_view method, const Params& params);
+        void sendFrame(JsonWriter& out, StatsClock::time_point start);
+        void parseMessage(std::string_view jsonContent);
+        void dispatch(Request& request);
+        // Destroys a request and hands its arena back to the pool
+        void releaseRequest(Request* request);
+        json collectStats();
+        static size_t methodCount();
+
+        // Request handlers. Each gets its params already decoded; the
+        // registry wires it up through invoke().
+        void onInitialize(const Request& request,
+                          const InitializeParams& params);
+        void onDidOpen(const Request& request,
+                       const DidOpenTextDocumentParams& params);
+        void onDidChangeContent(const Request& request,
+                                const DidChangeTextDocumentParams& params);
+        void onDidSave(const Request& request,
+                       const DidSaveTextDocumentParams& params);
+        void onDidClose(const Request& request,
+                        const DidCloseTextDocumentParams& params);
+        void onCompletion(const Request& request,
+                          const CompletionParams& params);
+        void onCompletionResolve(const Request& request,
+                                 const CompletionItem& item);
+        void onHover(const Request& request, const HoverParams& params);
+        void onDocumentDiagnostic(const Request& request,
+                                  const DocumentDiagnosticParams& params);
+        void onSetTrace(const Request& request, const SetTraceParams& params);
+        void onCancelRequest(const Request& request,
+                             const CancelParams& params);
+        void onStats(const Request& request, const NoParams& params);
+
+        template <typename Params,
+                  void (Server::*Handler)(const Request&, const Params&)>
+        void invoke(const Request& request) {
+            (this->*Handler)(request, std::get<Params>(request.params));
+        }
+
+        void scheduleValidation(std::string_view uri, int version,
+                                bool immediate);
+        void launchValidation(const std::string& uri, int version,
+                              DiagnosticsScheduler::CancelFlag cancelled);
+        void validateDocument(const std::string& uri, int version,
+                              const std::atomic<bool>& cancelled);
     };
 } // namespace LSP
\ No newline at end of file
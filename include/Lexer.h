@@ -0,0 +1,70 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace lsp {
+
+    enum class TokenKind : uint8_t {
+        Identifier,
+        Number,
+        String, // "..." or '...'
+        Comment,
+        Newline,
+        Operator,
+        LParen,
+        RParen,
+        LBrace,
+        RBrace,
+        LBracket,
+        RBracket,
+        Comma,
+        Dot,
+        Colon,
+        Semicolon,
+        Unknown,
+
+        // Keywords
+        KwAs,
+        KwBreak,
+        KwConst,
+        KwContinue,
+        KwElif,
+        KwElse,
+        KwExport,
+        KwFalse,
+        KwFn,
+        KwFor,
+        KwIf,
+        KwImport,
+        KwIn,
+        KwReturn,
+        KwStruct,
+        KwTrue,
+        KwVar,
+        KwWhile,
+    };
+
+    struct Token {
+        TokenKind kind;
+        uint32_t offset; // byte offset into the source
+        uint32_t length;
+
+        uint32_t end() const {
+            return offset + length;
+        }
+    };
+
+    // Tokenizes Swirl source in a single pass. Characters are classified
+    // through a 256-entry table, and comments and strings are skipped with
+    // memchr. Whitespace other than newlines is dropped; newlines are kept
+    // because they end statements in Swirl.
+    std::vector<Token> tokenize(std::string_view source);
+    void tokenize(std::string_view source, std::vector<Token>& out);
+
+    bool isKeyword(TokenKind kind);
+    // Trivia the parser and lint rules look past
+    inline bool isTrivia(TokenKind kind) {
+        return kind == TokenKind::Comment;
+    }
+} // namespace lsp
@@ -0,0 +1,73 @@
+#pragma once
+#include "Rope.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace lsp {
+
+    // Offsets of the first character of every line in a document. Built
+    // with a vectorized newline scan, so converting between LSP positions
+    // and byte offsets is a binary search plus a walk over a single line.
+    //
+    // The offsets are kept in blocks of lines shared between versions, as
+    // the tokens are: an edit rebuilds the blocks it touches, and the ones
+    // after it are only moved, so a copy or an edit costs one table entry
+    // per block rather than one per line.
+    //
+    // Columns are counted in UTF-16 code units as the protocol requires;
+    // lines end at '\n'.
+    class LineIndex {
+      public:
+        LineIndex();
+        explicit LineIndex(std::string_view text);
+        explicit LineIndex(const Rope& text);
+
+        size_t lineCount() const {
+            return count;
+        }
+        size_t lineStart(size_t line) const;
+        // Line containing the byte at `offset`
+        size_t lineOf(size_t offset) const;
+
+        // Updates the index for [offset, offset + length) being replaced
+        // by `text`.
+        void applyEdit(size_t offset, size_t length, std::string_view text);
+
+        // Position -> byte offset. Lines past the end map to the end of the
+        // text and columns past the end of a line clamp to the line end.
+        size_t offsetAt(std::string_view text, int line, int character) const;
+        size_t offsetAt(const Rope& text, int line, int character) const;
+
+        // Byte offset -> (line, UTF-16 column)
+        std::pair<int, int> positionAt(std::string_view text,
+                                       size_t offset) const;
+        std::pair<int, int> positionAt(const Rope& text, size_t offset) const;
+
+      private:
+        // Line starts of a run of lines, relative to the first, which is
+        // 0. A block covers its lines up to the next block's start.
+        using Block = std::vector<uint32_t>;
+        struct Piece {
+            std::shared_ptr<const Block> block;
+            size_t offset;    // start of the block's first line
+            size_t firstLine; // number of that line
+        };
+
+        std::vector<Piece> pieces;
+        size_t count = 0;
+
+        // Appends base + i + 1 for every '\n' at index i of `text`
+        static void scanNewlines(std::string_view text, size_t base,
+                                 std::vector<size_t>& out);
+        // Cuts ascending line starts into blocks appended to `pieces`
+        void appendBlocks(const std::vector<size_t>& starts);
+        // The piece holding the start of `line`, and the last piece
+        // starting at or before `offset`
+        size_t pieceOfLine(size_t line) const;
+        size_t pieceOfOffset(size_t offset) const;
+    };
+} // namespace lsp
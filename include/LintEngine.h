@@ -0,0 +1,163 @@
+#pragma once
+#include "Lexer.h"
+#include "Protocol.h"
+#include "TokenList.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace lsp {
+
+    // Symbols the lint automaton reads: every TokenKind, then one past the
+    // last token
+    constexpr size_t END_OF_TOKENS =
+        static_cast<size_t>(TokenKind::KwWhile) + 1;
+    constexpr size_t LINT_SYMBOLS = END_OF_TOKENS + 1;
+
+    // A set of symbols, one bit each
+    struct TokenSet {
+        uint64_t bits = 0;
+
+        static TokenSet of(std::initializer_list<TokenKind> kinds,
+                           bool endOfTokens = false);
+        // Every symbol but these, end of tokens included
+        static TokenSet except(std::initializer_list<TokenKind> kinds);
+
+        bool contains(size_t symbol) const {
+            return (bits >> symbol & 1) != 0;
+        }
+    };
+
+    // One step of a rule's pattern: a token from `set`, or any number of
+    // them when `repeat` is set
+    struct PatternStep {
+        TokenSet set;
+        bool repeat = false;
+    };
+
+    // A lint rule: a pattern over the tokens, comments skipped, and what
+    // to report where it matches. The reported range covers tokens
+    // counted back from the last one matched, 0 being that one, and must
+    // stay within the pattern's fixed-length tail. Rules sharing an id
+    // are alternative patterns of one rule, configured together.
+    struct LintRule {
+        std::string_view id;
+        std::string_view message;
+        DiagnosticSeverity severity;
+        std::vector<PatternStep> pattern;
+        uint8_t reportFrom = 0;
+        uint8_t reportTo = 0;
+    };
+
+    // Rules compiled together into one DFA over token kinds. Matching
+    // reads each token once, with one table lookup, however many rules
+    // there are; rule count only shows in the size of the table, built
+    // once up front.
+    class LintEngine {
+      public:
+        explicit LintEngine(std::vector<LintRule> rules);
+
+        size_t size() const {
+            return rules.size();
+        }
+        const LintRule& rule(size_t index) const {
+            return rules[index];
+        }
+        // Index of the first rule named `id`
+        std::optional<size_t> find(std::string_view id) const;
+
+        // Calls report(rule, offset, length) for every match, in token
+        // order. Returns false if `cancelled` was raised before the end.
+        template <typename F>
+        bool run(const TokenList& tokens, const std::atomic<bool>& cancelled,
+                 F&& report) const;
+
+        size_t stateCount() const {
+            return acceptStart.size() - 1;
+        }
+
+      private:
+        static constexpr size_t HISTORY = 8; // tokens reports reach back
+
+        std::vector<LintRule> rules;
+        std::vector<uint32_t> transitions; // state * LINT_SYMBOLS + symbol
+        std::vector<uint32_t> acceptStart; // per state, into `accepts`
+        std::vector<uint32_t> accepts;     // rules matching at a state
+
+        void compile();
+    };
+
+    // Severity each rule reports with, or off. Starts from the rules'
+    // defaults; safe to change while lint passes run.
+    class LintSettings {
+      public:
+        explicit LintSettings(const LintEngine& engine);
+
+        // Applies to every rule named `id`. Returns false if there is
+        // none.
+        bool set(std::string_view id,
+                 std::optional<DiagnosticSeverity> severity);
+        std::optional<DiagnosticSeverity> severity(size_t rule) const;
+
+      private:
+        const LintEngine& engine;
+        // DiagnosticSeverity value, 0 for off
+        std::unique_ptr<std::atomic<uint8_t>[]> levels;
+    };
+
+    // The server's rules, compiled on first use
+    const LintEngine& lintEngine();
+
+    template <typename F>
+    bool LintEngine::run(const TokenList& tokens,
+                         const std::atomic<bool>& cancelled,
+                         F&& report) const {
+        struct Seen {
+            uint32_t offset;
+            uint32_t end;
+        };
+        Seen history[HISTORY] = {};
+        size_t seen = 0;
+        uint32_t state = 0;
+        uint32_t last = 0;
+
+        auto step = [&](size_t symbol, uint32_t offset, uint32_t end) {
+            history[seen++ % HISTORY] = {offset, end};
+            state = transitions[state * LINT_SYMBOLS + symbol];
+            for (uint32_t i = acceptStart[state]; i < acceptStart[state + 1];
+                 ++i) {
+                const LintRule& matched = rules[accepts[i]];
+                const Seen& from = history[(seen - 1 - matched.reportFrom) %
+                                           HISTORY];
+                const Seen& to = history[(seen - 1 - matched.reportTo) %
+                                         HISTORY];
+                report(size_t{accepts[i]}, size_t{from.offset},
+                       size_t{to.end - from.offset});
+            }
+        };
+
+        size_t count = 0;
+        for (const TokenList::Piece& piece : tokens.blocks()) {
+            if ((++count & 0xFF) == 0 &&
+                cancelled.load(std::memory_order_relaxed)) {
+                return false;
+            }
+            auto base = static_cast<uint32_t>(piece.offset);
+            for (const Token& token : piece.block->tokens()) {
+                if (isTrivia(token.kind)) {
+                    continue;
+                }
+                step(static_cast<size_t>(token.kind), base + token.offset,
+                     base + token.end());
+                last = base + token.end();
+            }
+        }
+        step(END_OF_TOKENS, last, last);
+        return true;
+    }
+} // namespace lsp
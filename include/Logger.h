@@ -0,0 +1,123 @@
+#pragma once
+#include <atomic>
+#include <charconv>
+#include <concepts>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace lsp {
+
+    enum class LogLevel : uint8_t { Error, Warn, Info, Debug };
+
+    // Asynchronous leveled logger. Every thread appends finished lines to a
+    // ring buffer of its own; a background thread drains all rings, orders
+    // the lines by timestamp and hands them to stderr in a single write.
+    // Nothing on the logging path takes a lock or makes a syscall, and a
+    // disabled level costs a relaxed load and a branch (see LSP_LOG).
+    class Logger {
+      public:
+        static Logger& instance();
+
+        ~Logger();
+        Logger(const Logger&) = delete;
+        Logger& operator=(const Logger&) = delete;
+
+        bool enabled(LogLevel level) const {
+            return level <= threshold.load(std::memory_order_relaxed);
+        }
+        void setLevel(LogLevel level) {
+            threshold.store(level, std::memory_order_relaxed);
+        }
+        LogLevel level() const {
+            return threshold.load(std::memory_order_relaxed);
+        }
+
+        // Appends a finished line to the calling thread's ring. Lines that
+        // don't fit are dropped and counted rather than blocking the caller.
+        void write(LogLevel level, std::string_view line);
+
+        // Blocks until everything logged so far has reached stderr
+        void flush();
+
+        // Per-thread buffer of finished lines, see Logger.cpp
+        struct Ring;
+
+      private:
+        Logger();
+
+        std::atomic<LogLevel> threshold{LogLevel::Info};
+
+        std::mutex ringsMutex;
+        std::vector<std::shared_ptr<Ring>> rings;
+
+        // Set to 1 by the first write after a drain; the drain thread
+        // sleeps on it. 32-bit so waiting maps straight onto a futex.
+        std::atomic<uint32_t> pending{0};
+        std::atomic<uint32_t> flushRequested{0};
+        std::atomic<uint32_t> flushCompleted{0};
+        std::atomic<bool> stopping{false};
+        std::thread thread;
+
+        Ring& localRing();
+        void wake();
+        void loop();
+        void drain(std::string& out);
+    };
+
+    // Formats one log line into a reusable thread-local buffer and commits
+    // it to the logger when it goes out of scope.
+    class LogLine {
+      public:
+        LogLine(LogLevel level, std::string_view tag);
+        ~LogLine();
+        LogLine(const LogLine&) = delete;
+        LogLine& operator=(const LogLine&) = delete;
+
+        LogLine& operator<<(std::string_view text) {
+            buffer.append(text);
+            return *this;
+        }
+        LogLine& operator<<(const char* text) {
+            buffer.append(text);
+            return *this;
+        }
+        LogLine& operator<<(const std::string& text) {
+            buffer.append(text);
+            return *this;
+        }
+        LogLine& operator<<(char c) {
+            buffer.push_back(c);
+            return *this;
+        }
+        template <typename T>
+            requires std::integral<T> || std::floating_point<T>
+        LogLine& operator<<(T value) {
+            char digits[32];
+            auto result = std::to_chars(digits, digits + sizeof digits, value);
+            buffer.append(digits, result.ptr);
+            return *this;
+        }
+
+      private:
+        LogLevel level;
+        std::string& buffer;
+        // Where this line starts in the buffer, so a line logged while
+        // formatting another one doesn't clobber it
+        size_t start;
+    };
+
+    std::string_view toString(LogLevel level);
+} // namespace lsp
+
+// Streams a line at the given level; the arguments are not evaluated at all
+// when the level is disabled.
+//     LSP_LOG(Debug, "Hover") << uri;
+#define LSP_LOG(LEVEL, TAG)                                                    \
+    if (!::lsp::Logger::instance().enabled(::lsp::LogLevel::LEVEL)) {          \
+    } else                                                                     \
+        ::lsp::LogLine(::lsp::LogLevel::LEVEL, TAG)
@@ -0,0 +1,23 @@
+#pragma once
+#include <string>
+#include <string_view>
+
+namespace lsp {
+
+    // Top-level fields of a JSON-RPC message, located without building a
+    // DOM. Views point into the message body.
+    struct Envelope {
+        std::string_view method; // unescaped; empty for responses
+        std::string_view id;     // raw JSON, empty if absent
+        std::string_view params; // raw JSON, empty if absent
+        // Backing store for a method name that contained escapes
+        std::string methodStorage;
+    };
+
+    // Scans the outer object of a message and records where method, id and
+    // params are. Nested values are skipped over, not parsed, so this costs
+    // one pass over the bytes. Returns false if the body is not an object
+    // or is cut short; the contents of params are not validated here, that
+    // happens when they are decoded into the method's params struct.
+    bool scanEnvelope(std::string_view body, Envelope& envelope);
+} // namespace lsp
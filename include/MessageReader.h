@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace lsp {
+
+    // Reads Content-Length framed LSP messages straight from a file
+    // descriptor. Input is read in large chunks into a reusable buffer and
+    // bodies are handed out as views into it, so a message is never copied
+    // between the kernel and the JSON parser.
+    class MessageReader {
+      public:
+        explicit MessageReader(int fd, size_t initialCapacity = 64 * 1024);
+
+        // Returns the body of the next message, or std::nullopt once the
+        // stream is closed. The view stays valid until the next call.
+        std::optional<std::string_view> next();
+
+        // Bytes read from the descriptor so far, headers included
+        uint64_t bytesRead() const {
+            return totalRead;
+        }
+
+      private:
+        int fd;
+        std::vector<char> buffer;
+        size_t begin = 0; // first unconsumed byte
+        size_t end = 0;   // one past the last byte read
+        uint64_t totalRead = 0;
+
+        // Makes room and reads more input. Returns false on end of stream.
+        bool fill();
+        // Parses a header block (without the terminating blank line).
+        // Returns false if no valid Content-Length header was found.
+        static bool parseHeaders(std::string_view headers,
+                                 size_t& contentLength);
+    };
+} // namespace lsp
@@ -0,0 +1,71 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace lsp {
+
+    // Writes Content-Length framed messages to a file descriptor from a
+    // dedicated thread. Any thread may call send(); frames go through a
+    // lock-free multi-producer queue and the writer thread drains them in
+    // bursts, handing all queued headers and bodies to a single writev().
+    class MessageWriter {
+      public:
+        // flushLatency bounds how long the writer keeps a burst open to
+        // coalesce more frames before writing it out. Zero writes as soon
+        // as the queue runs dry.
+        explicit MessageWriter(int fd, std::chrono::microseconds flushLatency =
+                                           std::chrono::microseconds(20));
+        ~MessageWriter();
+
+        MessageWriter(const MessageWriter&) = delete;
+        MessageWriter& operator=(const MessageWriter&) = delete;
+
+        // Queues a serialized JSON body for sending.
+        void send(std::string body);
+
+        // Queues a frame that already carries its header, such as one
+        // built by JsonWriter. The frame starts at `offset` in `buffer`.
+        void sendFrame(std::string buffer, size_t offset);
+
+        // Writes out everything queued so far and stops the writer thread.
+        void close();
+
+        // Bytes handed to the kernel so far
+        uint64_t bytesWritten() const {
+            return written.load(std::memory_order_relaxed);
+        }
+
+      private:
+        struct Frame {
+            std::atomic<Frame*> next{nullptr};
+            std::string header; // empty if `body` is already framed
+            std::string body;
+            size_t offset = 0; // bytes of `body` to skip
+        };
+
+        int fd;
+        std::chrono::microseconds flushLatency;
+
+        // Intrusive MPSC queue: producers exchange `head`, the writer
+        // thread owns `tail`. `stub` keeps the queue non-empty.
+        std::atomic<Frame*> head;
+        Frame* tail;
+        Frame stub;
+
+        // Bumped on every send so the writer thread can sleep on it
+        std::atomic<uint32_t> signal{0};
+        std::atomic<bool> stopping{false};
+        std::atomic<uint64_t> written{0};
+        bool broken = false;
+        std::thread thread;
+
+        void push(Frame* frame);
+        Frame* pop();
+        void loop();
+        void writeBatch(std::vector<Frame*>& batch);
+    };
+} // namespace lsp
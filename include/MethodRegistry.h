@@ -0,0 +1,125 @@
+#pragma once
+#include "Request.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace lsp {
+
+    class Server;
+
+    enum class MethodKind : uint8_t {
+        Request,     // expects a response with the same id
+        Notification // fire and forget
+    };
+
+    enum class Priority : uint8_t {
+        Low,
+        Normal,
+        High,
+        Immediate // handled on the reader thread, ahead of anything queued
+    };
+
+    // Static description of an LSP method the server understands
+    struct MethodInfo {
+        std::string_view name;
+        // Thunk that hands the decoded params to the typed handler
+        void (Server::*handler)(const Request& request);
+        MethodKind kind;
+        bool cancellable;   // honours $/cancelRequest
+        Priority priority;  // scheduling hint
+        bool sequential;    // applied in arrival order, one at a time
+        // Reads the content of an open document: dispatch hands it the
+        // snapshot, or answers null without running it if none is open
+        bool needsSnapshot;
+        // Decodes the raw params into Request::params; false if they are
+        // malformed or miss a required field
+        bool (*decode)(std::string_view params, Request& request);
+    };
+
+    // Minimal perfect hash over a fixed set of method names, built entirely
+    // at compile time. A lookup is one hash over the name, one slot load and
+    // one string compare, with no allocation.
+    template <size_t N, size_t TableSize>
+    class MethodTable {
+        static_assert((TableSize & (TableSize - 1)) == 0,
+                      "TableSize must be a power of two");
+        static_assert(N < TableSize, "TableSize must exceed the method count");
+
+      public:
+        constexpr explicit MethodTable(const MethodInfo (&methods)[N]) {
+            for (size_t i = 0; i < N; ++i) {
+                entries[i] = methods[i];
+            }
+            // Search for a seed that sends every name to its own slot
+            for (seed = 1; seed != 0; ++seed) {
+                if (tryBuild()) {
+                    return;
+                }
+            }
+        }
+
+        constexpr const MethodInfo* find(std::string_view name) const {
+            uint8_t slot = slots[hash(name, seed) & (TableSize - 1)];
+            if (slot == 0 || entries[slot - 1].name != name) {
+                return nullptr;
+            }
+            return &entries[slot - 1];
+        }
+
+        constexpr size_t size() const {
+            return N;
+        }
+
+        constexpr const MethodInfo& operator[](size_t index) const {
+            return entries[index];
+        }
+
+        constexpr size_t indexOf(const MethodInfo* info) const {
+            return static_cast<size_t>(info - entries.data());
+        }
+
+      private:
+        std::array<MethodInfo, N> entries{};
+        std::array<uint8_t, TableSize> slots{}; // entry index + 1, 0 = empty
+        uint32_t seed = 0;
+
+        // FNV-1a over the name, salted with the seed
+        static constexpr uint32_t hash(std::string_view name, uint32_t seed) {
+            uint32_t h = 2166136261u ^ seed;
+            for (char c : name) {
+                h ^= static_cast<uint8_t>(c);
+                h *= 16777619u;
+            }
+            return h ^ (h >> 15);
+        }
+
+        constexpr bool tryBuild() {
+            slots = {};
+            for (size_t i = 0; i < N; ++i) {
+                size_t slot = hash(entries[i].name, seed) & (TableSize - 1);
+                if (slots[slot] != 0) {
+                    return false;
+                }
+                slots[slot] = static_cast<uint8_t>(i + 1);
+            }
+            return true;
+        }
+    };
+
+    // Smallest power of two table with at least twice as many slots as
+    // methods, which keeps the seed search short.
+    constexpr size_t methodTableSize(size_t count) {
+        size_t size = 1;
+        while (size < count * 2) {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    template <size_t N>
+    constexpr auto makeMethodTable(const MethodInfo (&methods)[N]) {
+        return MethodTable<N, methodTableSize(N)>(methods);
+    }
+} // namespace lsp
@@ -0,0 +1,25 @@
+#pragma once
+#include "Rope.h"
+#include "SyntaxTree.h"
+#include "TokenList.h"
+#include <cstddef>
+#include <memory>
+
+namespace lsp {
+
+    // Recursive-descent parser for Swirl that never fails: what it cannot
+    // make sense of becomes Error nodes and syntax errors, and parsing
+    // resumes at the next line or closing brace. `tokens` are the tokens
+    // of `text`.
+    std::shared_ptr<const SyntaxTree> parseSyntax(const Rope& text,
+                                                  const TokenList& tokens);
+
+    // The tree of `text`, which is the text `previous` was parsed from
+    // with `edit` applied. Chunks before the edit are kept as they are,
+    // but for the last one, whose final item may continue into the edit;
+    // chunks after it are shifted. Only the items in between are parsed
+    // again, until the parser reaches the start of an old chunk.
+    std::shared_ptr<const SyntaxTree>
+    reparseSyntax(const SyntaxTree& previous, const Rope& text,
+                  const TokenList& tokens, const EditSpan& edit);
+} // namespace lsp
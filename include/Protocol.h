@@ -0,0 +1,364 @@
+#pragma once
+#include "Reflect.h"
+#include "json.hpp"
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+using json = nlohmann::json;
+
+namespace lsp {
+
+    // The LSP types the server reads and writes. Each has a field table
+    // (FieldsOf) from which ProtocolCodec.h derives its JSON mapping; a
+    // field that is not std::optional is required when decoding. Only the
+    // members the server uses are modelled, others are skipped.
+    //
+    // Strings and lists of decoded messages are views into the request's
+    // arena (see Arena.h) and are only valid while its handler runs.
+
+    // Zero-based line and UTF-16 column, as used on the wire
+    struct Position {
+        int line = 0;
+        int character = 0;
+    };
+
+    template <> struct FieldsOf<Position> {
+        static constexpr auto value =
+            std::tuple{field("line", &Position::line),
+                       field("character", &Position::character)};
+    };
+
+    struct Range {
+        Position start;
+        Position end;
+    };
+
+    template <> struct FieldsOf<Range> {
+        static constexpr auto value = std::tuple{
+            field("start", &Range::start), field("end", &Range::end)};
+    };
+
+    // A single entry of textDocument/didChange's contentChanges
+    struct TextChange {
+        std::optional<Range> range; // no range: replace the whole text
+        std::string_view text;
+    };
+
+    template <> struct FieldsOf<TextChange> {
+        static constexpr auto value = std::tuple{
+            field("range", &TextChange::range), field("text", &TextChange::text)};
+    };
+
+    struct TextDocumentIdentifier {
+        std::string_view uri;
+    };
+
+    template <> struct FieldsOf<TextDocumentIdentifier> {
+        static constexpr auto value =
+            std::tuple{field("uri", &TextDocumentIdentifier::uri)};
+    };
+
+    struct TextDocumentItem {
+        std::string_view uri;
+        std::string_view languageId;
+        int version = 0;
+        std::string_view text;
+    };
+
+    template <> struct FieldsOf<TextDocumentItem> {
+        static constexpr auto value =
+            std::tuple{field("uri", &TextDocumentItem::uri),
+                       field("languageId", &TextDocumentItem::languageId),
+                       field("version", &TextDocumentItem::version),
+                       field("text", &TextDocumentItem::text)};
+    };
+
+    struct VersionedTextDocumentIdentifier {
+        std::string_view uri;
+        int version = 0;
+    };
+
+    template <> struct FieldsOf<VersionedTextDocumentIdentifier> {
+        static constexpr auto value =
+            std::tuple{field("uri", &VersionedTextDocumentIdentifier::uri),
+                       field("version",
+                             &VersionedTextDocumentIdentifier::version)};
+    };
+
+    // Params of the messages the server handles
+
+    // For methods that take no params
+    struct NoParams {};
+
+    template <> struct FieldsOf<NoParams> {
+        static constexpr auto value = std::tuple{};
+    };
+
+    // The client capabilities the server acts on
+    struct CompletionListCapabilities {
+        // CompletionList.itemDefaults properties the client understands
+        std::optional<std::span<const std::string_view>> itemDefaults;
+    };
+
+    template <> struct FieldsOf<CompletionListCapabilities> {
+        static constexpr auto value = std::tuple{field(
+            "itemDefaults", &CompletionListCapabilities::itemDefaults)};
+    };
+
+    struct CompletionClientCapabilities {
+        std::optional<CompletionListCapabilities> completionList;
+    };
+
+    template <> struct FieldsOf<CompletionClientCapabilities> {
+        static constexpr auto value = std::tuple{field(
+            "completionList", &CompletionClientCapabilities::completionList)};
+    };
+
+    struct TextDocumentClientCapabilities {
+        std::optional<CompletionClientCapabilities> completion;
+    };
+
+    template <> struct FieldsOf<TextDocumentClientCapabilities> {
+        static constexpr auto value = std::tuple{
+            field("completion", &TextDocumentClientCapabilities::completion)};
+    };
+
+    struct ClientCapabilities {
+        std::optional<TextDocumentClientCapabilities> textDocument;
+    };
+
+    template <> struct FieldsOf<ClientCapabilities> {
+        static constexpr auto value = std::tuple{
+            field("textDocument", &ClientCapabilities::textDocument)};
+    };
+
+    struct InitializeParams {
+        std::optional<int64_t> processId;
+        std::optional<std::string_view> rootUri;
+        std::optional<ClientCapabilities> capabilities;
+        std::optional<std::string_view> trace; // "off", "messages", "verbose"
+        std::optional<json> initializationOptions;
+    };
+
+    template <> struct FieldsOf<InitializeParams> {
+        static constexpr auto value = std::tuple{
+            field("processId", &InitializeParams::processId),
+            field("rootUri", &InitializeParams::rootUri),
+            field("capabilities", &InitializeParams::capabilities),
+            field("trace", &InitializeParams::trace),
+            field("initializationOptions",
+                  &InitializeParams::initializationOptions)};
+    };
+
+    struct DidOpenTextDocumentParams {
+        TextDocumentItem textDocument;
+    };
+
+    template <> struct FieldsOf<DidOpenTextDocumentParams> {
+        static constexpr auto value = std::tuple{
+            field("textDocument", &DidOpenTextDocumentParams::textDocument)};
+    };
+
+    struct DidChangeTextDocumentParams {
+        VersionedTextDocumentIdentifier textDocument;
+        std::span<const TextChange> contentChanges;
+    };
+
+    template <> struct FieldsOf<DidChangeTextDocumentParams> {
+        static constexpr auto value = std::tuple{
+            field("textDocument", &DidChangeTextDocumentParams::textDocument),
+            field("contentChanges",
+                  &DidChangeTextDocumentParams::contentChanges)};
+    };
+
+    struct DidSaveTextDocumentParams {
+        TextDocumentIdentifier textDocument;
+        std::optional<std::string_view> text;
+    };
+
+    template <> struct FieldsOf<DidSaveTextDocumentParams> {
+        static constexpr auto value = std::tuple{
+            field("textDocument", &DidSaveTextDocumentParams::textDocument),
+            field("text", &DidSaveTextDocumentParams::text)};
+    };
+
+    struct DidCloseTextDocumentParams {
+        TextDocumentIdentifier textDocument;
+    };
+
+    template <> struct FieldsOf<DidCloseTextDocumentParams> {
+        static constexpr auto value = std::tuple{
+            field("textDocument", &DidCloseTextDocumentParams::textDocument)};
+    };
+
+    struct TextDocumentPositionParams {
+        TextDocumentIdentifier textDocument;
+        Position position;
+    };
+
+    template <> struct FieldsOf<TextDocumentPositionParams> {
+        static constexpr auto value = std::tuple{
+            field("textDocument", &TextDocumentPositionParams::textDocument),
+            field("position", &TextDocumentPositionParams::position)};
+    };
+
+    using HoverParams = TextDocumentPositionParams;
+
+    struct CompletionContext {
+        int triggerKind = 1; // 1 = invoked, 2 = trigger character
+        std::optional<std::string_view> triggerCharacter;
+    };
+
+    template <> struct FieldsOf<CompletionContext> {
+        static constexpr auto value = std::tuple{
+            field("triggerKind", &CompletionContext::triggerKind),
+            field("triggerCharacter", &CompletionContext::triggerCharacter)};
+    };
+
+    struct CompletionParams {
+        TextDocumentIdentifier textDocument;
+        Position position;
+        std::optional<CompletionContext> context;
+    };
+
+    template <> struct FieldsOf<CompletionParams> {
+        static constexpr auto value = std::tuple{
+            field("textDocument", &CompletionParams::textDocument),
+            field("position", &CompletionParams::position),
+            field("context", &CompletionParams::context)};
+    };
+
+    struct SetTraceParams {
+        std::string_view value;
+    };
+
+    template <> struct FieldsOf<SetTraceParams> {
+        static constexpr auto value =
+            std::tuple{field("value", &SetTraceParams::value)};
+    };
+
+    struct CancelParams {
+        json id; // integer or string
+    };
+
+    template <> struct FieldsOf<CancelParams> {
+        static constexpr auto value =
+            std::tuple{field("id", &CancelParams::id)};
+    };
+
+    struct DocumentDiagnosticParams {
+        TextDocumentIdentifier textDocument;
+        std::optional<std::string_view> identifier;
+        // resultId of the report the client holds
+        std::optional<std::string_view> previousResultId;
+    };
+
+    template <> struct FieldsOf<DocumentDiagnosticParams> {
+        static constexpr auto value = std::tuple{
+            field("textDocument", &DocumentDiagnosticParams::textDocument),
+            field("identifier", &DocumentDiagnosticParams::identifier),
+            field("previousResultId",
+                  &DocumentDiagnosticParams::previousResultId)};
+    };
+
+    // Results and notifications the server sends
+
+    struct MarkupContent {
+        std::string_view kind; // "plaintext" or "markdown"
+        std::string value;
+    };
+
+    template <> struct FieldsOf<MarkupContent> {
+        static constexpr auto value =
+            std::tuple{field("kind", &MarkupContent::kind),
+                       field("value", &MarkupContent::value)};
+    };
+
+    struct Hover {
+        MarkupContent contents;
+    };
+
+    template <> struct FieldsOf<Hover> {
+        static constexpr auto value =
+            std::tuple{field("contents", &Hover::contents)};
+    };
+
+    // Sent in completion results and read back by completionItem/resolve.
+    // Outgoing items point at static strings. Results carry label and kind
+    // only; detail and documentation are filled in on resolve.
+    struct CompletionItem {
+        std::string_view label;
+        // Defaulted, so designated initializers may leave them out
+        std::optional<int> kind = {}; // CompletionItemKind, 1 = Text
+        std::optional<std::string_view> sortText = {};
+        std::optional<std::string_view> detail = {};
+        std::optional<MarkupContent> documentation = {};
+        std::optional<json> data = {}; // round-tripped to resolve as is
+    };
+
+    template <> struct FieldsOf<CompletionItem> {
+        static constexpr auto value =
+            std::tuple{field("label", &CompletionItem::label),
+                       field("kind", &CompletionItem::kind),
+                       field("sortText", &CompletionItem::sortText),
+                       field("detail", &CompletionItem::detail),
+                       field("documentation", &CompletionItem::documentation),
+                       field("data", &CompletionItem::data)};
+    };
+
+    enum class DiagnosticSeverity : int {
+        Error = 1,
+        Warning = 2,
+        Information = 3,
+        Hint = 4,
+    };
+
+    struct Diagnostic {
+        Range range;
+        DiagnosticSeverity severity = DiagnosticSeverity::Error;
+        std::string message;
+        std::string source;
+        std::optional<std::string> code; // lint rule id
+    };
+
+    template <> struct FieldsOf<Diagnostic> {
+        static constexpr auto value =
+            std::tuple{field("range", &Diagnostic::range),
+                       field("severity", &Diagnostic::severity),
+                       field("message", &Diagnostic::message),
+                       field("source", &Diagnostic::source),
+                       field("code", &Diagnostic::code)};
+    };
+
+    struct PublishDiagnosticsParams {
+        std::string uri;
+        std::optional<int> version;
+        std::vector<Diagnostic> diagnostics;
+    };
+
+    template <> struct FieldsOf<PublishDiagnosticsParams> {
+        static constexpr auto value = std::tuple{
+            field("uri", &PublishDiagnosticsParams::uri),
+            field("version", &PublishDiagnosticsParams::version),
+            field("diagnostics", &PublishDiagnosticsParams::diagnostics)};
+    };
+
+    // Reply to textDocument/diagnostic: "full" with the items, or
+    // "unchanged" when the client's previousResultId is still current
+    struct DocumentDiagnosticReport {
+        std::string_view kind;
+        std::string resultId;
+        std::optional<std::vector<Diagnostic>> items;
+    };
+
+    template <> struct FieldsOf<DocumentDiagnosticReport> {
+        static constexpr auto value =
+            std::tuple{field("kind", &DocumentDiagnosticReport::kind),
+                       field("resultId", &DocumentDiagnosticReport::resultId),
+                       field("items", &DocumentDiagnosticReport::items)};
+    };
+} // namespace lsp
@@ -0,0 +1,213 @@
+#pragma once
+#include "JsonReader.h"
+#include "JsonWriter.h"
+#include "Protocol.h"
+#include "Reflect.h"
+#include "json.hpp"
+#include <cstring>
+#include <new>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+using json = nlohmann::json;
+
+namespace lsp {
+
+    // JSON encoding and decoding of protocol types, generated from their
+    // field tables (Reflect.h). Supported members are strings, bools,
+    // integers, doubles, enums (as their integer value), std::optional,
+    // std::vector, nested reflected structs and json (LSPAny).
+    //
+    // std::string_view and std::span<const T> members are decoded into the
+    // reader's arena: the decoded value owns no heap memory and is released
+    // wholesale with the arena.
+
+    template <typename T> struct IsVector : std::false_type {};
+    template <typename T>
+    struct IsVector<std::vector<T>> : std::true_type {};
+
+    template <typename T> struct IsSpan : std::false_type {};
+    template <typename T>
+    struct IsSpan<std::span<const T>> : std::true_type {};
+
+    template <typename T> void writeJson(JsonWriter& out, const T& value) {
+        if constexpr (Reflected<T>) {
+            out.beginObject();
+            forEachField<T>([&](const auto& f, auto) {
+                const auto& member = value.*f.member;
+                using Member = std::remove_cvref_t<decltype(member)>;
+                // Absent optionals are left out rather than sent as null
+                if constexpr (IsOptional<Member>::value) {
+                    if (!member) {
+                        return;
+                    }
+                }
+                out.key(f.name);
+                writeJson(out, member);
+            });
+            out.endObject();
+        } else if constexpr (IsOptional<T>::value) {
+            if (value) {
+                writeJson(out, *value);
+            } else {
+                out.value(nullptr);
+            }
+        } else if constexpr (IsVector<T>::value || IsSpan<T>::value) {
+            out.beginArray();
+            for (const auto& element : value) {
+                writeJson(out, element);
+            }
+            out.endArray();
+        } else if constexpr (std::is_enum_v<T>) {
+            out.value(static_cast<std::underlying_type_t<T>>(value));
+        } else {
+            out.value(value);
+        }
+    }
+
+    template <typename T> bool readJson(JsonReader& in, T& value);
+
+    // Reads an array into arena memory. The elements are built in place and
+    // the storage doubles as it fills; the outgrown copies stay behind in
+    // the arena until it is reset.
+    template <typename T>
+    bool readList(JsonReader& in, std::span<const T>& value) {
+        static_assert(std::is_trivially_copyable_v<T> &&
+                          std::is_trivially_destructible_v<T>,
+                      "arena lists hold plain data");
+        Arena* arena = in.allocator();
+        if (arena == nullptr || !in.beginArray()) {
+            return in.fail();
+        }
+        T* data = nullptr;
+        size_t size = 0;
+        size_t capacity = 0;
+        while (in.nextElement()) {
+            if (size == capacity) {
+                capacity = capacity == 0 ? 4 : capacity * 2;
+                T* grown = arena->allocateArray<T>(capacity);
+                if (size != 0) {
+                    std::memcpy(grown, data, size * sizeof(T));
+                }
+                data = grown;
+            }
+            T* element = new (data + size) T();
+            if (!readJson(in, *element)) {
+                return false;
+            }
+            ++size;
+        }
+        value = std::span<const T>(data, size);
+        return in.ok();
+    }
+
+    template <typename T> bool readJson(JsonReader& in, T& value) {
+        if constexpr (Reflected<T>) {
+            constexpr uint64_t required = requiredFields<T>();
+            uint64_t seen = 0;
+            if (!in.beginObject()) {
+                return false;
+            }
+            std::string_view key;
+            while (in.nextMember(key)) {
+                bool known = false;
+                bool valid = true;
+                forEachField<T>([&](const auto& f, auto index) {
+                    if (known || key != f.name) {
+                        return;
+                    }
+                    known = true;
+                    valid = readJson(in, value.*f.member);
+                    seen |= uint64_t{1} << index;
+                });
+                // Fields we don't model are fine, LSP keeps adding them
+                if (!known) {
+                    valid = in.skipValue();
+                }
+                if (!valid) {
+                    return in.fail();
+                }
+            }
+            return in.ok() && (seen & required) == required;
+        } else if constexpr (IsOptional<T>::value) {
+            // null reads as absent
+            if (in.readNull()) {
+                value.reset();
+                return true;
+            }
+            return readJson(in, value.emplace());
+        } else if constexpr (IsVector<T>::value) {
+            value.clear();
+            if (!in.beginArray()) {
+                return false;
+            }
+            while (in.nextElement()) {
+                if (!readJson(in, value.emplace_back())) {
+                    return false;
+                }
+            }
+            return in.ok();
+        } else if constexpr (IsSpan<T>::value) {
+            return readList(in, value);
+        } else if constexpr (std::is_same_v<T, std::string> ||
+                             std::is_same_v<T, std::string_view>) {
+            return in.readString(value);
+        } else if constexpr (std::is_same_v<T, bool>) {
+            return in.readBool(value);
+        } else if constexpr (std::is_enum_v<T>) {
+            int64_t number;
+            if (!in.readInteger(number)) {
+                return false;
+            }
+            value = static_cast<T>(number);
+            return true;
+        } else if constexpr (std::is_integral_v<T>) {
+            int64_t number;
+            if (!in.readInteger(number)) {
+                return false;
+            }
+            if (!std::in_range<T>(number)) {
+                return in.fail();
+            }
+            value = static_cast<T>(number);
+            return true;
+        } else if constexpr (std::is_floating_point_v<T>) {
+            double number;
+            if (!in.readDouble(number)) {
+                return false;
+            }
+            value = static_cast<T>(number);
+            return true;
+        } else if constexpr (std::is_same_v<T, json>) {
+            std::string_view raw;
+            if (!in.readRaw(raw)) {
+                return false;
+            }
+            value = json::parse(raw, nullptr, false);
+            if (value.is_discarded()) {
+                return in.fail();
+            }
+            return true;
+        } else {
+            static_assert(!sizeof(T), "type has no JSON mapping");
+        }
+    }
+
+    // Decodes a complete JSON text into `value` in one pass. Empty text
+    // (a message without params) decodes like an empty object. Returns
+    // false on malformed JSON, wrong types or missing required fields.
+    // Views in `value` point into `arena`, not into `text`.
+    template <typename T>
+    bool decodeJson(std::string_view text, T& value, Arena& arena) {
+        if (text.empty() || text == "null") {
+            text = "{}";
+        }
+        JsonReader in(text, &arena);
+        return readJson(in, value) && in.atEnd();
+    }
+} // namespace lsp
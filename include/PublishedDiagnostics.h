@@ -0,0 +1,54 @@
+#pragma once
+#include "Protocol.h"
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace lsp {
+
+    // Digest of a diagnostics array: equal arrays hash equal, so a
+    // republish of the same set can be told apart without keeping it
+    uint64_t diagnosticsHash(const std::vector<Diagnostic>& diagnostics);
+
+    // The result id of a pull response for diagnostics with this hash
+    std::string diagnosticsResultId(uint64_t hash);
+
+    // Hash of the diagnostics last published for each document. Most
+    // edits leave the diagnostics as they were, and sending the same set
+    // again only makes the client redraw it.
+    class PublishedDiagnostics {
+      public:
+        // Records `hash` for version `version` of `uri`. Returns true if
+        // it differs from what was published last and should be sent;
+        // false for a repeat, or for a version older than the last one
+        // recorded, whose results are stale.
+        bool update(std::string_view uri, int version, uint64_t hash);
+
+        // The version and hash last recorded for `uri`
+        struct Entry {
+            int version;
+            uint64_t hash;
+        };
+        std::optional<Entry> find(std::string_view uri) const;
+
+        // Drops `uri`, so its next diagnostics are always sent
+        void forget(std::string_view uri);
+
+      private:
+        struct UriHash {
+            using is_transparent = void;
+            size_t operator()(std::string_view uri) const {
+                return std::hash<std::string_view>{}(uri);
+            }
+        };
+
+        mutable std::mutex mutex;
+        std::unordered_map<std::string, Entry, UriHash, std::equal_to<>>
+            entries;
+    };
+} // namespace lsp
@@ -0,0 +1,65 @@
+#pragma once
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <tuple>
+#include <utility>
+
+namespace lsp {
+
+    // Compile-time field tables. A struct becomes serializable by
+    // specializing FieldsOf with a tuple of its members and their JSON
+    // names; the encoder and decoder in ProtocolCodec.h are generated from
+    // that table, so there is no per-type serialization code.
+    //
+    //     template <> struct FieldsOf<Position> {
+    //         static constexpr auto value =
+    //             std::tuple{field("line", &Position::line),
+    //                        field("character", &Position::character)};
+    //     };
+    template <typename T> struct FieldsOf;
+
+    template <typename T, typename Member> struct Field {
+        using Type = Member;
+        std::string_view name;
+        Member T::*member;
+    };
+
+    template <typename T, typename Member>
+    constexpr Field<T, Member> field(std::string_view name,
+                                     Member T::*member) {
+        return {name, member};
+    }
+
+    template <typename T>
+    concept Reflected = requires { FieldsOf<T>::value; };
+
+    template <typename T> struct IsOptional : std::false_type {};
+    template <typename T>
+    struct IsOptional<std::optional<T>> : std::true_type {};
+
+    // Calls f(field, index) for every entry of T's field table
+    template <Reflected T, typename F> constexpr void forEachField(F&& f) {
+        constexpr auto& fields = FieldsOf<T>::value;
+        [&]<size_t... I>(std::index_sequence<I...>) {
+            (f(std::get<I>(fields), std::integral_constant<size_t, I>{}),
+             ...);
+        }(std::make_index_sequence<std::tuple_size_v<
+              std::remove_cvref_t<decltype(fields)>>>{});
+    }
+
+    // Bit mask of the fields a decoded message must carry: everything that
+    // is not a std::optional
+    template <Reflected T> constexpr uint64_t requiredFields() {
+        uint64_t mask = 0;
+        forEachField<T>([&](const auto& f, auto index) {
+            using Member = typename std::remove_cvref_t<decltype(f)>::Type;
+            if (!IsOptional<Member>::value) {
+                mask |= uint64_t{1} << index;
+            }
+        });
+        return mask;
+    }
+} // namespace lsp
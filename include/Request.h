@@ -0,0 +1,70 @@
+#pragma once
+#include "Arena.h"
+#include "Protocol.h"
+#include "json.hpp"
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <memory>
+#include <variant>
+
+using json = nlohmann::json;
+
+namespace lsp {
+
+    struct MethodInfo;
+    struct DocumentSnapshot;
+
+    // JSON-RPC / LSP error codes used by the server
+    enum class ErrorCode : int {
+        InvalidParams = -32602,
+        MethodNotFound = -32601,
+        InternalError = -32603,
+        RequestCancelled = -32800,
+    };
+
+    // Thrown from a handler once it notices its request was cancelled
+    struct RequestCancelled : std::exception {
+        const char* what() const noexcept override {
+            return "Request cancelled";
+        }
+    };
+
+    // Params of every method, decoded by the method's registry entry. A new
+    // params type has to be listed here.
+    using MethodParams =
+        std::variant<NoParams, InitializeParams, DidOpenTextDocumentParams,
+                     DidChangeTextDocumentParams, DidSaveTextDocumentParams,
+                     DidCloseTextDocumentParams, TextDocumentPositionParams,
+                     CompletionParams, CompletionItem,
+                     DocumentDiagnosticParams, SetTraceParams, CancelParams>;
+
+    // An incoming message on its way to a handler. Requests are built in
+    // the arena that holds their decoded params and go back to the pool
+    // with it once handled.
+    struct Request {
+        const MethodInfo* method = nullptr;
+        Arena* arena = nullptr;
+        json id; // null for notifications
+        bool hasId = false;
+        MethodParams params;
+        // Set by $/cancelRequest; null for requests that can't be cancelled
+        std::shared_ptr<std::atomic<bool>> cancelled;
+        // When the reader thread handed the message over
+        std::chrono::steady_clock::time_point received;
+        // The open document named by the params, taken at dispatch for
+        // methods that need a snapshot; null for all others
+        std::shared_ptr<const DocumentSnapshot> document;
+
+        bool isCancelled() const {
+            return cancelled && cancelled->load(std::memory_order_relaxed);
+        }
+
+        // Cooperative cancellation point for long-running handlers
+        void checkCancelled() const {
+            if (isCancelled()) {
+                throw RequestCancelled();
+            }
+        }
+    };
+} // namespace lsp
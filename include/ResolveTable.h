@@ -0,0 +1,56 @@
+#pragma once
+#include "CompletionCache.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace lsp {
+
+    // Completion results recently sent, so completionItem/resolve can find
+    // an item again from the [handle, index] pair in its data. Results are
+    // kept in a ring of fixed size: a client only resolves items of the
+    // list it is showing, so older results are simply overwritten and their
+    // handles stop resolving.
+    class ResolveTable {
+      public:
+        explicit ResolveTable(size_t capacity = 32);
+
+        // What a handle leads back to
+        struct Item {
+            const CompletionCache* cache;
+            CompletionCache::ItemId item;
+            // The document and version the completion was computed for;
+            // declaration offsets refer to that version
+            std::string uri;
+            int version;
+            // Keeps `cache` alive
+            std::shared_ptr<const void> owner;
+        };
+
+        // Records the entries of `result` and returns the handle to send
+        // with them
+        uint64_t add(std::string_view uri, int version,
+                     const CompletionResult& result);
+
+        // The item at `index` of result `handle`, unless it was evicted
+        std::optional<Item> find(uint64_t handle, uint32_t index) const;
+
+      private:
+        struct Slot {
+            uint64_t handle = 0;
+            std::string uri;
+            int version = 0;
+            std::vector<CompletionEntry> entries;
+            std::shared_ptr<const void> owner;
+        };
+
+        mutable std::mutex mutex;
+        std::vector<Slot> slots;
+        uint64_t nextHandle = 1;
+    };
+} // namespace lsp
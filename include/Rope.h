@@ -0,0 +1,123 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace lsp {
+
+    // Immutable text rope. Text is held in chunks of at most a couple of KB
+    // arranged as an implicit treap ordered by position. Edits return a new
+    // rope that shares every untouched node with the old one, so replacing a
+    // range costs O(log n) plus the size of the inserted text, independent
+    // of the document size, and old versions stay valid and cheap to keep.
+    class Rope {
+      public:
+        Rope() = default;
+        explicit Rope(std::string_view text);
+
+        size_t size() const;
+        bool empty() const {
+            return size() == 0;
+        }
+
+        // Returns a copy of this rope with [offset, offset + length)
+        // replaced by `text`. Out of range values are clamped.
+        Rope replace(size_t offset, size_t length, std::string_view text) const;
+
+        char at(size_t offset) const;
+        std::string substr(size_t offset, size_t length) const;
+        std::string toString() const;
+
+        // Whether [offset, offset + length) holds the same text as
+        // [otherOffset, otherOffset + length) of `other`. Chunks the two
+        // ropes share are matched by address, so comparing versions a few
+        // edits apart only walks their chunks.
+        bool sameText(size_t offset, const Rope& other, size_t otherOffset,
+                      size_t length) const;
+
+        // Calls f(std::string_view) for each chunk in order until it returns
+        // false.
+        template <typename F>
+        void forEachChunk(F&& f) const {
+            visit(root.get(), f);
+        }
+
+        // Same, restricted to the characters in [offset, offset + length).
+        // Chunks are clipped to the range and no nodes are copied.
+        template <typename F>
+        void forEachChunk(size_t offset, size_t length, F&& f) const {
+            visitRange(root.get(), offset, offset + length, f);
+        }
+
+      private:
+        struct Node;
+        using NodePtr = std::shared_ptr<const Node>;
+
+        struct Node {
+            NodePtr left;
+            NodePtr right;
+            std::string chunk;
+            size_t length; // total characters in this subtree
+            uint32_t priority;
+        };
+
+        NodePtr root;
+
+        // Walks the chunks in order from a given offset
+        class Cursor;
+
+        explicit Rope(NodePtr root) : root(std::move(root)) {}
+
+        static size_t length(const NodePtr& node) {
+            return node ? node->length : 0;
+        }
+        static NodePtr make(NodePtr left, std::string chunk, NodePtr right,
+                            uint32_t priority);
+        static NodePtr build(std::string_view text);
+        static std::pair<NodePtr, NodePtr> split(const NodePtr& node,
+                                                 size_t offset);
+        static NodePtr merge(const NodePtr& a, const NodePtr& b);
+        static const Node* first(const Node* node);
+        static const Node* last(const Node* node);
+
+        template <typename F>
+        static bool visit(const Node* node, F& f) {
+            if (node == nullptr) {
+                return true;
+            }
+            return visit(node->left.get(), f) &&
+                   f(std::string_view(node->chunk)) &&
+                   visit(node->right.get(), f);
+        }
+
+        // [begin, end) is relative to the start of `node`'s subtree
+        template <typename F>
+        static bool visitRange(const Node* node, size_t begin, size_t end,
+                               F& f) {
+            if (node == nullptr || begin >= end || begin >= node->length) {
+                return true;
+            }
+            size_t leftLength = length(node->left);
+            if (begin < leftLength &&
+                !visitRange(node->left.get(), begin, end, f)) {
+                return false;
+            }
+            size_t chunkEnd = leftLength + node->chunk.size();
+            if (begin < chunkEnd && end > leftLength) {
+                size_t from = begin > leftLength ? begin - leftLength : 0;
+                size_t to = std::min(end, chunkEnd) - leftLength;
+                if (!f(std::string_view(node->chunk).substr(from, to - from))) {
+                    return false;
+                }
+            }
+            if (end > chunkEnd) {
+                size_t from = begin > chunkEnd ? begin - chunkEnd : 0;
+                return visitRange(node->right.get(), from, end - chunkEnd, f);
+            }
+            return true;
+        }
+    };
+} // namespace lsp
@@ -0,0 +1,69 @@
+#pragma once
+#include "MethodRegistry.h"
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace lsp {
+
+    // Runs handler work on a pool of worker threads.
+    //
+    // Sequential tasks (document mutations, lifecycle messages) run one at a
+    // time in submission order. Every other task runs in parallel, but only
+    // once all sequential tasks submitted before it have finished, and a
+    // sequential task waits for the parallel tasks submitted before it. A
+    // hover therefore sees exactly the edits that preceded it. Among
+    // runnable tasks, higher priority goes first.
+    class Scheduler {
+      public:
+        struct Task {
+            std::function<void()> run;
+            Priority priority = Priority::Normal;
+            bool sequential = false;
+            // Parallel task that doesn't hold back later sequential tasks,
+            // for work that tolerates seeing newer document content
+            bool detached = false;
+        };
+
+        explicit Scheduler(size_t workerCount = 0);
+        ~Scheduler();
+
+        Scheduler(const Scheduler&) = delete;
+        Scheduler& operator=(const Scheduler&) = delete;
+
+        void submit(Task task);
+
+        // Runs everything still queued, then stops the workers.
+        void shutdown();
+
+      private:
+        struct Queued {
+            std::function<void()> run;
+            uint64_t barrier; // sequential tasks submitted before this one
+            bool detached;
+        };
+
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::deque<Queued> sequentialQueue;
+        // Parallel tasks, indexed by Priority
+        std::array<std::deque<Queued>, 3> parallelQueues;
+        uint64_t submittedSequential = 0;
+        uint64_t completedSequential = 0;
+        // Unfinished non-detached parallel tasks per barrier value
+        std::map<uint64_t, size_t> pendingParallel;
+        bool sequentialRunning = false;
+        bool stopping = false;
+        std::vector<std::thread> workers;
+
+        void workerLoop();
+        bool sequentialReady() const;
+        bool idle() const;
+    };
+} // namespace lsp
@@ -0,0 +1,70 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace lsp {
+
+    // Binary session trace: every message body the server read or wrote,
+    // with a monotonic timestamp, so a user's exact traffic can be replayed
+    // against another build (see swirl_lsp_loadgen --replay).
+    //
+    // Layout, little-endian:
+    //   file:   "SWLTRACE" u32 formatVersion  record*
+    //   record: u8 direction  u64 nanoseconds  u32 length  body[length]
+    //
+    // Timestamps count from the start of the recording. Bodies are stored
+    // without their headers; replay frames them again with Content-Length.
+    enum class TraceDirection : uint8_t { Inbound = 0, Outbound = 1 };
+
+    struct TraceRecord {
+        TraceDirection direction;
+        uint64_t nanoseconds;
+        std::string body;
+    };
+
+    inline constexpr std::string_view TRACE_MAGIC = "SWLTRACE";
+    inline constexpr uint32_t TRACE_FORMAT_VERSION = 1;
+
+    // Appends records from any thread; a background thread writes them
+    // out in batches so recording stays off the request path.
+    class TraceRecorder {
+      public:
+        // Throws std::runtime_error if the file can't be created
+        explicit TraceRecorder(const std::string& path);
+        ~TraceRecorder();
+
+        TraceRecorder(const TraceRecorder&) = delete;
+        TraceRecorder& operator=(const TraceRecorder&) = delete;
+
+        void record(TraceDirection direction, std::string_view body);
+
+        // Writes out everything recorded so far and closes the file
+        void close();
+
+      private:
+        std::FILE* file;
+        std::chrono::steady_clock::time_point start;
+
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::string pending; // encoded records not yet written
+        bool stopping = false;
+        std::thread thread;
+
+        void loop();
+    };
+
+    // Reads a whole trace. Throws std::runtime_error if the file is
+    // missing or not a trace; a truncated last record is dropped.
+    std::vector<TraceRecord> loadTrace(const std::string& path);
+
+    // Whether the file starts with the trace magic
+    bool isTraceFile(const std::string& path);
+} // namespace lsp
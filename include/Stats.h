@@ -0,0 +1,84 @@
+#pragma once
+#include "json.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+using json = nlohmann::json;
+
+namespace lsp {
+
+    // Lock-free log-linear latency histogram in the spirit of HDR
+    // histograms. Each power of two is split into 16 linear sub-buckets,
+    // bounding the relative error of reported percentiles at about 6%.
+    // Recording is a handful of relaxed atomic adds.
+    class LatencyHistogram {
+      public:
+        void record(uint64_t nanoseconds);
+
+        uint64_t count() const {
+            return total.load(std::memory_order_relaxed);
+        }
+        // Lower bound of the bucket holding the q-quantile, in ns
+        uint64_t percentile(double q) const;
+
+        // count, mean, p50, p90, p99, p999 and max in microseconds
+        json summary() const;
+
+      private:
+        static constexpr unsigned SUB_BUCKET_BITS = 4;
+        static constexpr unsigned SUB_BUCKETS = 1u << SUB_BUCKET_BITS;
+        static constexpr size_t BUCKETS = 64 * SUB_BUCKETS;
+
+        std::array<std::atomic<uint64_t>, BUCKETS> buckets{};
+        std::atomic<uint64_t> total{0};
+        std::atomic<uint64_t> sum{0};
+        std::atomic<uint64_t> max{0};
+
+        static size_t bucketOf(uint64_t value);
+        static uint64_t bucketStart(size_t index);
+    };
+
+    // Per-method breakdown of where a request's time goes
+    struct MethodStats {
+        LatencyHistogram queueWait; // received -> handler start
+        LatencyHistogram handler;   // handler run, serialization included
+        LatencyHistogram serialize; // json -> bytes
+    };
+
+    using StatsClock = std::chrono::steady_clock;
+
+    inline uint64_t elapsedNanoseconds(StatsClock::time_point since) {
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                StatsClock::now() - since)
+                .count());
+    }
+
+    // Server-wide counters and histograms, indexed by method table index
+    class ServerStats {
+      public:
+        explicit ServerStats(size_t methodCount);
+
+        MethodStats& method(size_t index) {
+            return methods[index];
+        }
+        const MethodStats& method(size_t index) const {
+            return methods[index];
+        }
+
+        // Background document validation
+        MethodStats validation;
+
+        std::atomic<uint64_t> bytesRead{0};
+        std::atomic<uint64_t> messagesRead{0};
+        std::atomic<uint64_t> messagesWritten{0};
+
+        StatsClock::time_point startTime = StatsClock::now();
+
+      private:
+        std::unique_ptr<MethodStats[]> methods;
+    };
+} // namespace lsp
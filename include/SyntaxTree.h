@@ -0,0 +1,262 @@
+#pragma once
+#include "Arena.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace lsp {
+
+    enum class NodeKind : uint8_t {
+        Error, // tokens the parser skipped to recover
+
+        // Declarations
+        Import,
+        Export,
+        Function,
+        ParamList,
+        Param,
+        Struct,
+        Field,
+        Var,
+        Const,
+        Type,
+
+        // Statements
+        Block,
+        If,
+        Elif,
+        Else,
+        While,
+        For,
+        Return,
+        Break,
+        Continue,
+        ExprStmt,
+
+        // Expressions
+        Name,
+        Literal,
+        Unary,
+        Binary, // a flat operand/operator chain, no precedence
+        Paren,
+        List,
+        Call,
+        ArgList,
+        Member,
+        Index,
+    };
+
+    // Declarations whose first child is the Name they declare
+    inline bool isDeclaration(NodeKind kind) {
+        switch (kind) {
+        case NodeKind::Function:
+        case NodeKind::Param:
+        case NodeKind::Struct:
+        case NodeKind::Field:
+        case NodeKind::Var:
+        case NodeKind::Const:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    struct SyntaxError {
+        uint32_t offset; // relative to the chunk in a SyntaxChunk
+        uint32_t length;
+        const char* message;
+    };
+
+    // Nodes under construction, one column per field, in pre-order: a
+    // node is followed by its descendants, and subtreeEnds[i] is one past
+    // the last of them.
+    struct NodeColumns {
+        std::vector<NodeKind> kinds;
+        std::vector<uint32_t> starts;
+        std::vector<uint32_t> ends;
+        std::vector<uint32_t> parents;
+        std::vector<uint32_t> subtreeEnds;
+
+        size_t size() const {
+            return kinds.size();
+        }
+        void clear();
+    };
+
+    // A run of consecutive top-level items, the unit the parser reuses
+    // across edits. The columns live in the chunk's own arena, back to
+    // back. Offsets are relative to the chunk start, so a chunk that only
+    // moved is shared as is.
+    class SyntaxChunk {
+      public:
+        static constexpr uint32_t NONE = UINT32_MAX;
+
+        // Copies nodes [first, last) of `nodes`, which must be whole
+        // top-level items, and `errors`, all of them at or after `offset`
+        SyntaxChunk(const NodeColumns& nodes, size_t first, size_t last,
+                    const SyntaxError* errors, size_t errorCount,
+                    uint32_t offset);
+
+        SyntaxChunk(const SyntaxChunk&) = delete;
+        SyntaxChunk& operator=(const SyntaxChunk&) = delete;
+
+        uint32_t size() const {
+            return count;
+        }
+        // From the chunk start to the end of its last item
+        uint32_t length() const {
+            return textLength;
+        }
+
+        NodeKind kind(uint32_t node) const {
+            return kinds[node];
+        }
+        uint32_t start(uint32_t node) const {
+            return starts[node];
+        }
+        uint32_t end(uint32_t node) const {
+            return ends[node];
+        }
+        // NONE for top-level items
+        uint32_t parent(uint32_t node) const {
+            return parents[node];
+        }
+        uint32_t subtreeEnd(uint32_t node) const {
+            return subtreeEnds[node];
+        }
+
+        uint32_t errorCount() const {
+            return errorTotal;
+        }
+        const SyntaxError& error(uint32_t index) const {
+            return errors[index];
+        }
+
+      private:
+        Arena arena;
+        uint32_t count;
+        uint32_t textLength;
+        uint32_t errorTotal;
+        NodeKind* kinds;
+        uint32_t* starts;
+        uint32_t* ends;
+        uint32_t* parents;
+        uint32_t* subtreeEnds;
+        SyntaxError* errors;
+    };
+
+    // A node of a SyntaxTree, with offsets in document coordinates
+    class SyntaxNode {
+      public:
+        SyntaxNode() = default;
+        SyntaxNode(const SyntaxChunk* chunk, uint32_t index, size_t base)
+            : chunk(chunk), index(index), base(base) {}
+
+        explicit operator bool() const {
+            return chunk != nullptr;
+        }
+
+        NodeKind kind() const {
+            return chunk->kind(index);
+        }
+        size_t start() const {
+            return base + chunk->start(index);
+        }
+        size_t end() const {
+            return base + chunk->end(index);
+        }
+
+        // Null for top-level items
+        SyntaxNode parent() const;
+        SyntaxNode firstChild() const;
+        // Null after the last child; top-level items have no siblings here,
+        // iterate them with SyntaxTree::forEachItem
+        SyntaxNode nextSibling() const;
+        // First child of the given kind
+        SyntaxNode child(NodeKind kind) const;
+
+        bool operator==(const SyntaxNode& other) const {
+            return chunk == other.chunk && index == other.index;
+        }
+
+      private:
+        const SyntaxChunk* chunk = nullptr;
+        uint32_t index = 0;
+        size_t base = 0;
+    };
+
+    // Concrete syntax tree of one document version: its top-level items,
+    // chunk by chunk. Chunks are immutable and shared between the trees of
+    // successive versions; a tree itself is only the table placing them.
+    class SyntaxTree {
+      public:
+        struct Piece {
+            std::shared_ptr<const SyntaxChunk> chunk;
+            size_t offset; // where the chunk starts in the document
+        };
+
+        explicit SyntaxTree(std::vector<Piece> pieces)
+            : pieces(std::move(pieces)) {}
+
+        const std::vector<Piece>& chunks() const {
+            return pieces;
+        }
+
+        // Calls f(SyntaxNode) for every top-level item, in order
+        template <typename F> void forEachItem(F&& f) const {
+            for (const Piece& piece : pieces) {
+                const SyntaxChunk& chunk = *piece.chunk;
+                for (uint32_t i = 0; i < chunk.size();
+                     i = chunk.subtreeEnd(i)) {
+                    f(SyntaxNode(&chunk, i, piece.offset));
+                }
+            }
+        }
+
+        // Calls f(SyntaxNode) for the top-level items that start before
+        // `offset`, in order, and stops at the first one that doesn't
+        template <typename F>
+        void forEachItemBefore(size_t offset, F&& f) const {
+            for (const Piece& piece : pieces) {
+                const SyntaxChunk& chunk = *piece.chunk;
+                for (uint32_t i = 0; i < chunk.size();
+                     i = chunk.subtreeEnd(i)) {
+                    if (piece.offset + chunk.start(i) >= offset) {
+                        return;
+                    }
+                    f(SyntaxNode(&chunk, i, piece.offset));
+                }
+            }
+        }
+
+        // Calls f(SyntaxNode) for every node, in document order
+        template <typename F> void forEachNode(F&& f) const {
+            for (const Piece& piece : pieces) {
+                const SyntaxChunk& chunk = *piece.chunk;
+                for (uint32_t i = 0; i < chunk.size(); ++i) {
+                    f(SyntaxNode(&chunk, i, piece.offset));
+                }
+            }
+        }
+
+        // Calls f(offset, length, message) for every syntax error
+        template <typename F> void forEachError(F&& f) const {
+            for (const Piece& piece : pieces) {
+                const SyntaxChunk& chunk = *piece.chunk;
+                for (uint32_t i = 0; i < chunk.errorCount(); ++i) {
+                    const SyntaxError& error = chunk.error(i);
+                    f(piece.offset + error.offset, size_t{error.length},
+                      error.message);
+                }
+            }
+        }
+
+        // Innermost node whose span contains `offset` (ends included), or
+        // null between items
+        SyntaxNode nodeAt(size_t offset) const;
+
+      private:
+        std::vector<Piece> pieces;
+    };
+} // namespace lsp
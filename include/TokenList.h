@@ -0,0 +1,132 @@
+#pragma once
+#include "Lexer.h"
+#include "Rope.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace lsp {
+
+    // The span an edit replaced: [start, oldEnd) of the old text became
+    // [start, newEnd) of the new one
+    struct EditSpan {
+        size_t start = 0;
+        size_t oldEnd = 0;
+        size_t newEnd = 0;
+
+        // Extends this edit by `next`, given in the coordinates of the
+        // text this one produced, so a batch of changes is redone once
+        void merge(const EditSpan& next) {
+            // Past the damaged span, the two texts only differ by a shift
+            if (next.oldEnd > newEnd) {
+                oldEnd += next.oldEnd - newEnd;
+            }
+            newEnd = newEnd >= next.oldEnd ? newEnd + next.newEnd - next.oldEnd
+                                           : next.newEnd;
+            start = std::min(start, next.start);
+        }
+    };
+
+    // Tokens of a run of lines. A block starts right after a Newline
+    // token: newlines inside comments are not tokens of their own, so the
+    // lexer holds no state there and can restart from the block alone.
+    // Offsets are relative to the block start, so a block that only moved
+    // is shared as is.
+    class TokenBlock {
+      public:
+        TokenBlock(std::vector<Token> tokens, uint32_t length)
+            : list(std::move(tokens)), textLength(length) {}
+
+        std::span<const Token> tokens() const {
+            return list;
+        }
+        // Text covered, up to the start of the next block
+        uint32_t length() const {
+            return textLength;
+        }
+
+      private:
+        std::vector<Token> list;
+        uint32_t textLength;
+    };
+
+    // Tokens of one document version, comments included, as a table of
+    // shared blocks. The block starts are the checkpoints relexing resumes
+    // from after an edit.
+    class TokenList {
+      public:
+        struct Piece {
+            std::shared_ptr<const TokenBlock> block;
+            size_t offset; // where the block starts in the document
+        };
+
+        explicit TokenList(std::vector<Piece> pieces);
+
+        const std::vector<Piece>& blocks() const {
+            return pieces;
+        }
+        // Number of tokens
+        size_t size() const {
+            return count;
+        }
+
+        // Walks the tokens in order, with offsets into the document
+        class Cursor {
+          public:
+            // At the first token starting at or after `offset`
+            Cursor(const TokenList& list, size_t offset);
+
+            bool atEnd() const {
+                return piece == list->pieces.size();
+            }
+            Token token() const {
+                const Piece& current = list->pieces[piece];
+                Token token = current.block->tokens()[index];
+                token.offset += static_cast<uint32_t>(current.offset);
+                return token;
+            }
+            void advance() {
+                ++index;
+                skipExhausted();
+            }
+
+          private:
+            const TokenList* list;
+            size_t piece;
+            size_t index;
+
+            void skipExhausted();
+        };
+
+        // Calls f(Token) for every token, with offsets into the document
+        template <typename F> void forEachToken(F&& f) const {
+            for (const Piece& piece : pieces) {
+                auto base = static_cast<uint32_t>(piece.offset);
+                for (Token token : piece.block->tokens()) {
+                    token.offset += base;
+                    f(token);
+                }
+            }
+        }
+
+      private:
+        std::vector<Piece> pieces;
+        size_t count = 0;
+    };
+
+    // Tokens of the whole text
+    std::shared_ptr<const TokenList> lexTokens(const Rope& text);
+
+    // Tokens of `text`, which is the text `previous` was lexed from with
+    // `edit` applied. Lexing restarts at the last checkpoint before the
+    // edit and stops at the first checkpoint after it where the new tokens
+    // line up with the old ones again. Blocks outside that range are
+    // shared, so the cost follows the size of the edit rather than of the
+    // document.
+    std::shared_ptr<const TokenList>
+    relexTokens(const TokenList& previous, const Rope& text,
+                const EditSpan& edit);
+} // namespace lsp
@@ -0,0 +1,321 @@
+#include "Analysis.h"
+#include "Parser.h"
+#include <algorithm>
+#include <cctype>
+#include <vector>
+
+namespace lsp {
+
+    std::string getWordAt(const Rope& content, const LineIndex& lines,
+                          int line, int character) {
+        if (content.empty()) return "";
+
+        size_t offset = lines.offsetAt(content, line, character);
+
+        // Only the line holding the position is looked at
+        size_t lineNumber = lines.lineOf(offset);
+        size_t lineStart = lines.lineStart(lineNumber);
+        size_t lineEnd = lineNumber + 1 < lines.lineCount()
+                             ? lines.lineStart(lineNumber + 1)
+                             : content.size();
+        std::string text = content.substr(lineStart, lineEnd - lineStart);
+        offset -= lineStart;
+
+        auto isWordChar = [](char c) {
+            return std::isalnum(static_cast<unsigned char>(c)) != 0;
+        };
+        size_t start = offset, end = offset;
+        while (start > 0 && isWordChar(text[start - 1])) start--;
+        while (end < text.size() && isWordChar(text[end])) end++;
+
+        if (start >= end) return "";
+        return text.substr(start, end - start);
+    }
+
+    std::pair<int, int> calculatePosition(std::string_view content,
+                                          const LineIndex& lines,
+                                          size_t offset) {
+        return lines.positionAt(content, offset);
+    }
+
+    std::pair<int, int> calculatePosition(const Rope& content,
+                                          const LineIndex& lines,
+                                          size_t offset) {
+        return lines.positionAt(content, offset);
+    }
+
+    std::shared_ptr<const TokenList>
+    tokenList(const DocumentSnapshot& document) {
+        return document.tokens ? document.tokens : lexTokens(document.text);
+    }
+
+    std::shared_ptr<const SyntaxTree>
+    syntaxTree(const DocumentSnapshot& document) {
+        if (document.syntax) {
+            return document.syntax;
+        }
+        return parseSyntax(document.text, *tokenList(document));
+    }
+
+    std::string nodeText(const DocumentSnapshot& document, SyntaxNode node) {
+        return document.text.substr(node.start(), node.end() - node.start());
+    }
+
+    std::optional<std::vector<Diagnostic>>
+    computeDiagnostics(const DocumentSnapshot& document,
+                       const std::atomic<bool>& cancelled,
+                       const LintSettings* settings) {
+        std::shared_ptr<const TokenList> tokens = tokenList(document);
+        std::shared_ptr<const SyntaxTree> tree = syntaxTree(document);
+        if (cancelled.load(std::memory_order_relaxed)) {
+            return std::nullopt;
+        }
+
+        std::vector<Diagnostic> diagnostics;
+        auto report = [&](size_t offset, size_t length,
+                          DiagnosticSeverity severity, std::string message,
+                          std::optional<std::string> code) {
+            // Calculate line and character positions
+            auto start_pos =
+                calculatePosition(document.text, document.lines, offset);
+            auto end_pos = calculatePosition(document.text, document.lines,
+                                             offset + length);
+            diagnostics.push_back({{{start_pos.first, start_pos.second},
+                                    {end_pos.first, end_pos.second}},
+                                   severity,
+                                   std::move(message),
+                                   "Swirl",
+                                   std::move(code)});
+        };
+
+        tree->forEachError([&](size_t offset, size_t length,
+                               const char* message) {
+            report(offset, length, DiagnosticSeverity::Error, message,
+                   std::nullopt);
+        });
+
+        // Every lint rule in one pass over the tokens
+        const LintEngine& engine = lintEngine();
+        bool finished = engine.run(
+            *tokens, cancelled, [&](size_t rule, size_t offset, size_t length) {
+                std::optional<DiagnosticSeverity> severity =
+                    settings ? settings->severity(rule)
+                             : std::optional{engine.rule(rule).severity};
+                if (!severity) {
+                    return;
+                }
+                const LintRule& matched = engine.rule(rule);
+                report(offset, length, *severity, std::string(matched.message),
+                       std::string(matched.id));
+            });
+
+        if (!finished || cancelled.load(std::memory_order_relaxed)) {
+            return std::nullopt;
+        }
+        // In document order, syntax errors and lint reports interleaved
+        auto before = [](const Diagnostic& a, const Diagnostic& b) {
+            const Position& x = a.range.start;
+            const Position& y = b.range.start;
+            return x.line != y.line ? x.line < y.line
+                                    : x.character < y.character;
+        };
+        std::stable_sort(diagnostics.begin(), diagnostics.end(), before);
+        return diagnostics;
+    }
+
+    // Whether the text of `node` is `name`, compared in the rope
+    static bool hasText(const DocumentSnapshot& document, SyntaxNode node,
+                        std::string_view name) {
+        if (node.end() - node.start() != name.size()) {
+            return false;
+        }
+        size_t matched = 0;
+        bool equal = true;
+        document.text.forEachChunk(
+            node.start(), name.size(), [&](std::string_view chunk) {
+                equal = chunk == name.substr(matched, chunk.size());
+                matched += chunk.size();
+                return equal;
+            });
+        return equal;
+    }
+
+    // The Name a statement or parameter declares, or null
+    static SyntaxNode declaredName(SyntaxNode node) {
+        if (node.kind() == NodeKind::Export) {
+            node = node.firstChild();
+        }
+        if (!node || !isDeclaration(node.kind())) {
+            return {};
+        }
+        SyntaxNode declared = node.firstChild();
+        if (!declared || declared.kind() != NodeKind::Name) {
+            return {};
+        }
+        return declared;
+    }
+
+    std::string hoverText(const DocumentSnapshot& document,
+                          Position position) {
+        std::shared_ptr<const SyntaxTree> tree = syntaxTree(document);
+        size_t offset = document.lines.offsetAt(document.text, position.line,
+                                                position.character);
+        SyntaxNode node = tree->nodeAt(offset);
+        if (!node || node.kind() != NodeKind::Name) {
+            return "No info available";
+        }
+        std::string name = nodeText(document, node);
+
+        // A declared name stands for itself. A use is looked up scope by
+        // scope outward from it, preferring the closest declaration
+        // before it in each: the statements of each enclosing block, the
+        // parameters of the enclosing function, then the top-level items.
+        SyntaxNode declaration;
+        SyntaxNode parent = node.parent();
+        auto consider = [&](SyntaxNode candidate) {
+            SyntaxNode declared = declaredName(candidate);
+            if (declared && hasText(document, declared, name)) {
+                declaration = declared;
+            }
+        };
+        if (parent && isDeclaration(parent.kind()) &&
+            parent.firstChild() == node) {
+            declaration = node;
+        }
+        for (SyntaxNode scope = parent; scope && !declaration;
+             scope = scope.parent()) {
+            if (scope.kind() == NodeKind::Block) {
+                for (SyntaxNode statement = scope.firstChild();
+                     statement && statement.start() < offset;
+                     statement = statement.nextSibling()) {
+                    consider(statement);
+                }
+            } else if (scope.kind() == NodeKind::Function) {
+                SyntaxNode params = scope.child(NodeKind::ParamList);
+                for (SyntaxNode param = params ? params.firstChild()
+                                               : SyntaxNode();
+                     param; param = param.nextSibling()) {
+                    consider(param);
+                }
+            }
+        }
+        if (!declaration) {
+            tree->forEachItemBefore(offset, consider);
+        }
+
+        if (declaration) {
+            if (auto rendered = renderDeclaration(
+                    document, document.version, declaration.start(), name)) {
+                return *rendered;
+            }
+        }
+        return "Hover info for `" + name + "`";
+    }
+
+    const CompletionCache& completionItems() {
+        static const CompletionCache cache = [] {
+            CompletionCache items;
+            auto plain = [](std::string text) {
+                return MarkupContent{"plaintext", std::move(text)};
+            };
+            items.add({.label = "Hello",
+                       .kind = 1, // Text
+                       .detail = "Hello from swirl C++ lsp server",
+                       .documentation = plain(
+                           "Text completion from swirl LSP server")});
+            items.add({.label = "from",
+                       .kind = 2, // Method
+                       .detail = "from swirl C++ lsp server",
+                       .documentation = plain(
+                           "Method completion from swirl LSP server")});
+            items.add({.label = "swirl",
+                       .kind = 3, // Function
+                       .detail = "swirl C++ lsp server",
+                       .documentation = plain(
+                           "Function completion from swirl LSP server")});
+            items.add({.label = "C++",
+                       .kind = 6, // Class
+                       .detail = "C++ lsp server",
+                       .documentation = plain(
+                           "Class completion from swirl LSP server")});
+            items.add({.label = "lsp",
+                       .kind = 7, // Interface
+                       .detail = "lsp server",
+                       .documentation = plain(
+                           "Interface completion from swirl LSP server")});
+            items.add({.label = "server",
+                       .kind = 9, // Module
+                       .detail = "server",
+                       .documentation = plain(
+                           "Module completion from swirl LSP server")});
+            for (std::string_view keyword :
+                 {"as", "break", "const", "continue", "elif", "else",
+                  "export", "false", "fn", "for", "if", "import", "in",
+                  "return", "struct", "true", "var", "while"}) {
+                items.add({.label = keyword,
+                           .kind = 14, // Keyword
+                           .detail = "keyword"});
+            }
+            return items;
+        }();
+        return cache;
+    }
+
+    WordPrefix wordPrefix(const DocumentSnapshot& document,
+                          Position position) {
+        size_t offset = document.lines.offsetAt(document.text, position.line,
+                                                position.character);
+        size_t lineNumber = document.lines.lineOf(offset);
+        size_t lineStart = document.lines.lineStart(lineNumber);
+        std::string before =
+            document.text.substr(lineStart, offset - lineStart);
+
+        // The cursor column, clamped to the line as offsetAt did
+        int end = 0;
+        for (char c : before) {
+            auto byte = static_cast<unsigned char>(c);
+            if ((byte & 0xC0) != 0x80) {
+                end += byte >= 0xF0 ? 2 : 1; // astral: a surrogate pair
+            }
+        }
+        // Word characters are ASCII, so bytes and UTF-16 units agree
+        size_t start = before.size();
+        while (start > 0 &&
+               std::isalnum(static_cast<unsigned char>(before[start - 1]))) {
+            --start;
+        }
+        int line = static_cast<int>(lineNumber);
+        int length = static_cast<int>(before.size() - start);
+        return {{{line, end - length}, {line, end}},
+                lineStart + start,
+                before.substr(start)};
+    }
+
+    std::optional<std::string>
+    renderDeclaration(const DocumentSnapshot& document, int version,
+                      size_t offset, std::string_view name) {
+        if (offset > document.text.size() ||
+            name.size() > document.text.size() - offset) {
+            return std::nullopt;
+        }
+        // Edits since `version` may have moved the declaration
+        if (document.version != version &&
+            document.text.substr(offset, name.size()) != name) {
+            return std::nullopt;
+        }
+
+        size_t lineNumber = document.lines.lineOf(offset);
+        size_t lineStart = document.lines.lineStart(lineNumber);
+        size_t lineEnd = lineNumber + 1 < document.lines.lineCount()
+                             ? document.lines.lineStart(lineNumber + 1)
+                             : document.text.size();
+        std::string line =
+            document.text.substr(lineStart, lineEnd - lineStart);
+        size_t first = line.find_first_not_of(" \t");
+        size_t last = line.find_last_not_of(" \t\r\n");
+        if (first == std::string::npos) {
+            return std::nullopt;
+        }
+        return "```swirl\n" + line.substr(first, last - first + 1) + "\n```";
+    }
+} // namespace lsp
@@ -0,0 +1,97 @@
+#include "Arena.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace lsp {
+
+    Arena::Arena(size_t firstChunk) {
+        first = static_cast<Chunk*>(::operator new(sizeof(Chunk) + firstChunk));
+        first->next = nullptr;
+        first->size = firstChunk;
+        startChunk(first);
+    }
+
+    Arena::~Arena() {
+        reset();
+        ::operator delete(first);
+    }
+
+    void Arena::startChunk(Chunk* chunk) {
+        current = chunk;
+        cursor = begin(chunk);
+        limit = cursor + chunk->size;
+    }
+
+    void* Arena::allocateSlow(size_t size, size_t alignment) {
+        // Chunks double in size so a large request needs few of them; an
+        // oversized allocation gets a chunk of its own
+        retired += static_cast<size_t>(cursor - begin(current));
+        size_t chunkSize = std::max(current->size * 2, size + alignment);
+        auto* chunk =
+            static_cast<Chunk*>(::operator new(sizeof(Chunk) + chunkSize));
+        chunk->next = nullptr;
+        chunk->size = chunkSize;
+        current->next = chunk;
+        startChunk(chunk);
+
+        char* p = alignUp(cursor, alignment);
+        cursor = p + size;
+        return p;
+    }
+
+    std::string_view Arena::copy(std::string_view text) {
+        if (text.empty()) {
+            return {};
+        }
+        char* data = allocateArray<char>(text.size());
+        std::memcpy(data, text.data(), text.size());
+        return std::string_view(data, text.size());
+    }
+
+    void Arena::reset() {
+        Chunk* chunk = first->next;
+        while (chunk != nullptr) {
+            Chunk* next = chunk->next;
+            ::operator delete(chunk);
+            chunk = next;
+        }
+        first->next = nullptr;
+        retired = 0;
+        startChunk(first);
+    }
+
+    size_t Arena::bytesUsed() const {
+        return retired + static_cast<size_t>(cursor - begin(current));
+    }
+
+    ArenaPool::~ArenaPool() {
+        for (Arena* arena : idle) {
+            delete arena;
+        }
+    }
+
+    Arena* ArenaPool::acquire() {
+        {
+            std::lock_guard lock(mutex);
+            if (!idle.empty()) {
+                Arena* arena = idle.back();
+                idle.pop_back();
+                return arena;
+            }
+        }
+        return new Arena();
+    }
+
+    void ArenaPool::release(Arena* arena) {
+        arena->reset();
+        {
+            std::lock_guard lock(mutex);
+            if (idle.size() < maxIdle) {
+                idle.push_back(arena);
+                return;
+            }
+        }
+        delete arena;
+    }
+} // namespace lsp
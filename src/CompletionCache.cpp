@@ -0,0 +1,95 @@
+#include "CompletionCache.h"
+#include "ProtocolCodec.h"
+#include <algorithm>
+#include <charconv>
+
+namespace lsp {
+
+    CompletionCache::Slice CompletionCache::append(std::string_view text) {
+        Slice s{static_cast<uint32_t>(storage.size()),
+                static_cast<uint32_t>(text.size())};
+        storage += text;
+        return s;
+    }
+
+    CompletionCache::ItemId CompletionCache::add(const CompletionItem& item,
+                                                 uint32_t declaration) {
+        scratch.clear();
+        scratch.beginObject();
+        scratch.key("label");
+        size_t labelStart = scratch.body().size();
+        scratch.value(item.label);
+        size_t labelEnd = scratch.body().size();
+        if (item.kind) {
+            scratch.field("kind", *item.kind);
+        }
+        scratch.endObject();
+        // Without the braces
+        std::string_view members =
+            scratch.body().substr(1, scratch.body().size() - 2);
+
+        Item entry;
+        entry.label = append(item.label);
+        entry.members = append(members);
+        entry.encodedLabel =
+            Slice{entry.members.offset + static_cast<uint32_t>(labelStart - 1),
+                  static_cast<uint32_t>(labelEnd - labelStart)};
+        entry.detail = append(item.detail.value_or(""));
+        entry.documentation =
+            append(item.documentation ? item.documentation->value : "");
+        entry.declaration = declaration;
+        items.push_back(entry);
+        return static_cast<ItemId>(items.size() - 1);
+    }
+
+    void writeJson(JsonWriter& out, const CompletionResult& result) {
+        out.beginObject();
+        out.field("isIncomplete", result.isIncomplete);
+        if (result.editRange) {
+            out.key("itemDefaults");
+            out.beginObject();
+            out.key("editRange");
+            writeJson(out, *result.editRange);
+            out.endObject();
+        }
+        out.key("items");
+        out.beginArray();
+        uint32_t index = 0;
+        for (const CompletionEntry& entry : result.entries) {
+            out.beginObject();
+            out.rawMembers(entry.cache->members(entry.item));
+
+            // Fixed width so clients sorting by string keep rank order
+            char sortText[10] = "000000000";
+            char digits[10];
+            auto end = std::to_chars(digits, digits + sizeof digits,
+                                     entry.rank + 1)
+                           .ptr;
+            size_t length = static_cast<size_t>(end - digits);
+            size_t width = length < 4 ? 4 : length;
+            std::copy(digits, end, sortText + width - length);
+            out.field("sortText", std::string_view(sortText, width));
+
+            if (entry.replace) {
+                out.key("textEdit");
+                out.beginObject();
+                out.key("range");
+                writeJson(out, *entry.replace);
+                out.key("newText");
+                out.raw(entry.cache->encodedLabel(entry.item));
+                out.endObject();
+            }
+            if (result.handle != 0) {
+                out.key("data");
+                out.beginArray();
+                out.value(result.handle);
+                out.value(index);
+                out.endArray();
+            }
+            ++index;
+            out.endObject();
+        }
+        out.endArray();
+        out.endObject();
+    }
+} // namespace lsp
@@ -0,0 +1,237 @@
+#include "CompletionSession.h"
+#include "Analysis.h"
+#include "FuzzyMatcher.h"
+#include <algorithm>
+#include <string>
+#include <unordered_set>
+#include <utility>
+
+namespace lsp {
+
+    namespace {
+
+        // Bytes read from the rope at a time when collecting names
+        constexpr size_t NAME_WINDOW = 4096;
+
+        // CompletionItemKind of the names a declaration introduces, or 0
+        int completionKind(NodeKind kind) {
+            switch (kind) {
+            case NodeKind::Function:
+                return 3; // Function
+            case NodeKind::Field:
+                return 5; // Field
+            case NodeKind::Var:
+            case NodeKind::Param:
+                return 6; // Variable
+            case NodeKind::Const:
+                return 21; // Constant
+            case NodeKind::Struct:
+                return 22; // Struct
+            default:
+                return 0;
+            }
+        }
+    } // namespace
+
+    std::shared_ptr<CompletionSessions::Session>
+    CompletionSessions::startSession(const DocumentSnapshot* document,
+                                     size_t wordStart, int line,
+                                     int character) {
+        auto session = std::make_shared<Session>();
+        session->line = line;
+        session->character = character;
+
+        const CompletionCache& items = completionItems();
+        std::unordered_set<std::string_view> builtIn;
+        for (CompletionCache::ItemId id = 0; id < items.size(); ++id) {
+            builtIn.insert(items.label(id));
+        }
+
+        if (document != nullptr) {
+            session->version = document->version;
+            session->wordOffset = wordStart;
+            session->text = document->text;
+            std::shared_ptr<const SyntaxTree> tree = syntaxTree(*document);
+            // Nodes come in document order, so names are read from the
+            // rope a window at a time
+            std::string window;
+            size_t windowStart = 0;
+            auto text = [&](size_t start, size_t end) {
+                if (start < windowStart || end > windowStart + window.size()) {
+                    windowStart = start;
+                    window = document->text.substr(
+                        start, std::max(NAME_WINDOW, end - start));
+                }
+                return std::string_view(window).substr(start - windowStart,
+                                                       end - start);
+            };
+            std::unordered_set<std::string> seen;
+            tree->forEachNode([&](SyntaxNode node) {
+                int kind = completionKind(node.kind());
+                SyntaxNode name = node.firstChild();
+                // The word being typed is not a candidate for itself
+                if (kind == 0 || !name || name.kind() != NodeKind::Name ||
+                    name.start() == wordStart) {
+                    return;
+                }
+                std::string_view label = text(name.start(), name.end());
+                if (!builtIn.contains(label) &&
+                    seen.emplace(label).second) {
+                    session->symbols.add({label, kind, {}, {}, {}, {}},
+                                         name.start());
+                }
+            });
+        }
+
+        // Labels are taken once the symbol storage stops growing
+        const CompletionCache& symbols = session->symbols;
+        session->candidates.reserve(items.size() + symbols.size());
+        for (CompletionCache::ItemId id = 0; id < items.size(); ++id) {
+            session->candidates.push_back({&items, id, items.label(id)});
+        }
+        for (CompletionCache::ItemId id = 0; id < symbols.size(); ++id) {
+            session->candidates.push_back({&symbols, id, symbols.label(id)});
+        }
+        session->bags.reserve(session->candidates.size());
+        for (const Candidate& candidate : session->candidates) {
+            session->bags.push_back(charBag(candidate.label));
+        }
+        return session;
+    }
+
+    CompletionResult
+    CompletionSessions::complete(const DocumentSnapshot* document,
+                                 Position position) {
+        if (document == nullptr) {
+            return rank(startSession(nullptr, 0, 0, 0), "", std::nullopt);
+        }
+
+        WordPrefix word = wordPrefix(*document, position);
+        int line = word.range.start.line;
+        int character = word.range.start.character;
+
+        std::shared_ptr<Session> session;
+        {
+            std::lock_guard lock(mutex);
+            auto it = sessions.find(document->uri);
+            if (it != sessions.end() && it->second->line == line &&
+                it->second->character == character) {
+                session = it->second;
+            }
+        }
+        // Edits elsewhere since may have added or removed names
+        if (session && (session->wordOffset != word.offset ||
+                        !onlyWordChanged(*session, *document,
+                                         word.text.size()))) {
+            session.reset();
+        }
+        if (!session) {
+            // Gathering candidates walks the syntax tree, so it happens
+            // outside the lock
+            session = startSession(document, word.offset, line, character);
+            session->wordLength = word.text.size();
+            std::lock_guard lock(mutex);
+            sessions[document->uri] = session;
+        }
+        return rank(session, word.text, word.range);
+    }
+
+    bool CompletionSessions::onlyWordChanged(Session& session,
+                                             const DocumentSnapshot& document,
+                                             size_t wordLength) {
+        std::lock_guard lock(session.mutex);
+        const Rope& before = session.text;
+        const Rope& now = document.text;
+        size_t start = session.wordOffset;
+        // The same text, with the cursor moved within the word
+        if (now.size() == before.size() &&
+            now.sameText(0, before, 0, before.size())) {
+            session.wordLength = wordLength;
+            return true;
+        }
+        if (now.size() - wordLength != before.size() - session.wordLength) {
+            return false;
+        }
+        // Text before the word, then text after it
+        size_t tail = start + wordLength;
+        if (!now.sameText(0, before, 0, start) ||
+            !now.sameText(tail, before, start + session.wordLength,
+                          now.size() - tail)) {
+            return false;
+        }
+        session.text = now;
+        session.wordLength = wordLength;
+        return true;
+    }
+
+    CompletionResult
+    CompletionSessions::rank(const std::shared_ptr<Session>& session,
+                             std::string_view prefix,
+                             const std::optional<Range>& replace) {
+        std::lock_guard lock(session->mutex);
+        const std::vector<Candidate>& candidates = session->candidates;
+
+        // A longer prefix only matches a subset of what the shorter one
+        // did, so the previous matches are narrowed instead of starting
+        // over from every candidate
+        uint32_t needed = charBag(prefix);
+        std::vector<uint32_t> matches;
+        if (session->filtered && prefix.starts_with(session->prefix)) {
+            for (uint32_t index : session->matches) {
+                if ((session->bags[index] & needed) == needed) {
+                    matches.push_back(index);
+                }
+            }
+        } else {
+            filterByBag(session->bags.data(), session->bags.size(), needed,
+                        matches);
+        }
+
+        // The bag check lets through anagrams; scoring settles the order
+        std::vector<std::pair<int, uint32_t>> scored;
+        scored.reserve(matches.size());
+        session->matches.clear();
+        for (uint32_t index : matches) {
+            int score = fuzzyScore(prefix, candidates[index].label);
+            if (score >= 0) {
+                scored.emplace_back(score, index);
+                session->matches.push_back(index);
+            }
+        }
+        session->prefix = prefix;
+        session->filtered = true;
+
+        // Best score first; ties keep the candidate order, static items
+        // ahead of document symbols
+        size_t count = std::min(scored.size(), limit());
+        auto better = [](const std::pair<int, uint32_t>& a,
+                         const std::pair<int, uint32_t>& b) {
+            return a.first != b.first ? a.first > b.first
+                                      : a.second < b.second;
+        };
+        std::partial_sort(scored.begin(), scored.begin() + count,
+                          scored.end(), better);
+
+        CompletionResult result;
+        result.isIncomplete = scored.size() > count;
+        std::optional<Range> itemRange = replace;
+        if (defaultEditRange.load(std::memory_order_relaxed)) {
+            result.editRange = replace;
+            itemRange.reset();
+        }
+        result.entries.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            const Candidate& candidate = candidates[scored[i].second];
+            result.entries.push_back({candidate.cache, candidate.item,
+                                      static_cast<uint32_t>(i), itemRange});
+        }
+        result.version = session->version;
+        result.owner = session;
+        return result;
+    }
+
+    void CompletionSessions::forget(std::string_view uri) {
+        std::lock_guard lock(mutex);
+        sessions.erase(std::string(uri));
+    }
+} // namespace lsp
@@ -0,0 +1,114 @@
+#include "DiagnosticsScheduler.h"
+#include <vector>
+
+namespace lsp {
+
+    DiagnosticsScheduler::DiagnosticsScheduler(Launch launch,
+                                               std::chrono::milliseconds delay)
+        : launch(std::move(launch)), delay(delay) {
+        thread = std::thread([this] { loop(); });
+    }
+
+    DiagnosticsScheduler::~DiagnosticsScheduler() {
+        shutdown();
+    }
+
+    void DiagnosticsScheduler::schedule(const std::string& uri, int version,
+                                        bool immediate) {
+        {
+            std::lock_guard lock(mutex);
+            auto deadline = Clock::now();
+            if (!immediate) {
+                deadline += delay;
+            }
+            pending[uri] = {deadline, version};
+
+            // Whatever is running for this document is already stale
+            auto it = running.find(uri);
+            if (it != running.end()) {
+                it->second->store(true, std::memory_order_relaxed);
+            }
+        }
+        wake.notify_one();
+    }
+
+    void DiagnosticsScheduler::cancel(const std::string& uri) {
+        std::lock_guard lock(mutex);
+        pending.erase(uri);
+        auto it = running.find(uri);
+        if (it != running.end()) {
+            it->second->store(true, std::memory_order_relaxed);
+        }
+    }
+
+    void DiagnosticsScheduler::finished(const std::string& uri,
+                                        const CancelFlag& cancelled) {
+        std::lock_guard lock(mutex);
+        auto it = running.find(uri);
+        if (it != running.end() && it->second == cancelled) {
+            running.erase(it);
+        }
+    }
+
+    void DiagnosticsScheduler::setDelay(std::chrono::milliseconds newDelay) {
+        std::lock_guard lock(mutex);
+        delay = newDelay;
+    }
+
+    void DiagnosticsScheduler::shutdown() {
+        {
+            std::lock_guard lock(mutex);
+            if (stopping) {
+                return;
+            }
+            stopping = true;
+        }
+        wake.notify_one();
+        thread.join();
+    }
+
+    void DiagnosticsScheduler::start(std::unique_lock<std::mutex>& lock,
+                                     const std::string& uri, int version) {
+        auto cancelled = std::make_shared<std::atomic<bool>>(false);
+        running[uri] = cancelled;
+        // Launching may take other locks; don't hold ours meanwhile
+        lock.unlock();
+        launch(uri, version, cancelled);
+        lock.lock();
+    }
+
+    void DiagnosticsScheduler::loop() {
+        std::unique_lock lock(mutex);
+        while (true) {
+            if (stopping) {
+                // Flush instead of dropping the last edits' diagnostics
+                auto remaining = std::move(pending);
+                pending.clear();
+                for (auto& [uri, entry] : remaining) {
+                    start(lock, uri, entry.version);
+                }
+                return;
+            }
+            if (pending.empty()) {
+                wake.wait(lock);
+                continue;
+            }
+
+            auto next = pending.begin();
+            for (auto it = pending.begin(); it != pending.end(); ++it) {
+                if (it->second.deadline < next->second.deadline) {
+                    next = it;
+                }
+            }
+            if (Clock::now() < next->second.deadline) {
+                wake.wait_until(lock, next->second.deadline);
+                continue;
+            }
+
+            std::string uri = next->first;
+            int version = next->second.version;
+            pending.erase(next);
+            start(lock, uri, version);
+        }
+    }
+} // namespace lsp
@@ -0,0 +1,108 @@
+#include "DocumentStore.h"
+#include "Parser.h"
+
+namespace lsp {
+
+    SnapshotPtr DocumentStore::open(std::string_view uri,
+                                    std::string_view text, int version) {
+        Rope rope(text);
+        auto tokens = lexTokens(rope);
+        auto syntax = parseSyntax(rope, *tokens);
+        auto snapshot = std::make_shared<const DocumentSnapshot>(
+            DocumentSnapshot{std::string(uri), version, std::move(rope),
+                             LineIndex(text), std::move(tokens),
+                             std::move(syntax)});
+
+        std::lock_guard writeLock(writeMutex);
+        if (Entry* entry = find(uri)) {
+            entry->current.store(snapshot, std::memory_order_release);
+            return snapshot;
+        }
+        auto entry = std::make_unique<Entry>();
+        entry->current.store(snapshot, std::memory_order_relaxed);
+        std::unique_lock lock(mapMutex);
+        entries.emplace(uri, std::move(entry));
+        return snapshot;
+    }
+
+    SnapshotPtr DocumentStore::update(std::string_view uri,
+                                      std::span<const TextChange> changes,
+                                      int version) {
+        std::lock_guard writeLock(writeMutex);
+        Entry* entry = find(uri);
+        if (entry == nullptr) {
+            return nullptr;
+        }
+
+        SnapshotPtr base = entry->current.load(std::memory_order_acquire);
+        DocumentSnapshot next{base->uri, version, base->text, base->lines,
+                              base->tokens, base->syntax};
+        // The changes are folded into one edit for the lexer and parser
+        std::optional<EditSpan> edit;
+        bool replaced = false;
+        for (const TextChange& change : changes) {
+            if (!change.range) {
+                next.text = Rope(change.text);
+                next.lines = LineIndex(change.text);
+                replaced = true;
+                edit.reset();
+                continue;
+            }
+            // Each range is relative to the result of the previous change
+            size_t start = next.lines.offsetAt(next.text, change.range->start.line,
+                                               change.range->start.character);
+            size_t end = next.lines.offsetAt(next.text, change.range->end.line,
+                                             change.range->end.character);
+            if (end < start) {
+                std::swap(start, end);
+            }
+            next.lines.applyEdit(start, end - start, change.text);
+            next.text = next.text.replace(start, end - start, change.text);
+            if (!replaced) {
+                EditSpan current{start, end, start + change.text.size()};
+                if (edit) {
+                    edit->merge(current);
+                } else {
+                    edit = current;
+                }
+            }
+        }
+        if (replaced || !next.tokens || !next.syntax) {
+            next.tokens = lexTokens(next.text);
+            next.syntax = parseSyntax(next.text, *next.tokens);
+        } else if (edit) {
+            next.tokens = relexTokens(*next.tokens, next.text, *edit);
+            next.syntax =
+                reparseSyntax(*next.syntax, next.text, *next.tokens, *edit);
+        }
+
+        auto snapshot =
+            std::make_shared<const DocumentSnapshot>(std::move(next));
+        entry->current.store(snapshot, std::memory_order_release);
+        return snapshot;
+    }
+
+    void DocumentStore::close(std::string_view uri) {
+        std::lock_guard writeLock(writeMutex);
+        std::unique_lock lock(mapMutex);
+        auto it = entries.find(uri);
+        if (it != entries.end()) {
+            entries.erase(it);
+        }
+    }
+
+    SnapshotPtr DocumentStore::get(std::string_view uri) const {
+        std::shared_lock lock(mapMutex);
+        auto it = entries.find(uri);
+        if (it == entries.end()) {
+            return nullptr;
+        }
+        return it->second->current.load(std::memory_order_acquire);
+    }
+
+    DocumentStore::Entry* DocumentStore::find(std::string_view uri) const {
+        std::shared_lock lock(mapMutex);
+        auto it = entries.find(uri);
+        return it != entries.end() ? it->second.get() : nullptr;
+    }
+} // namespace lsp
@@ -0,0 +1,146 @@
+#include "FuzzyMatcher.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+    bool isLetter(char c) {
+        char lower = static_cast<char>(c | 0x20);
+        return lower >= 'a' && lower <= 'z';
+    }
+
+    bool isUpper(char c) {
+        return c >= 'A' && c <= 'Z';
+    }
+
+    bool isDigit(char c) {
+        return c >= '0' && c <= '9';
+    }
+
+    char foldCase(char c) {
+        return isUpper(c) ? static_cast<char>(c | 0x20) : c;
+    }
+
+    uint32_t bagBit(char c) {
+        if (isLetter(c)) {
+            return uint32_t{1} << ((c | 0x20) - 'a');
+        }
+        if (isDigit(c)) {
+            return uint32_t{1} << 26;
+        }
+        if (c == '_') {
+            return uint32_t{1} << 27;
+        }
+        return uint32_t{1} << 31;
+    }
+
+    // First byte in [p, end) equal to `lower` or `upper`
+    const char* findFolded(const char* p, const char* end, char lower,
+                           char upper) {
+#if defined(__SSE2__)
+        const __m128i lowers = _mm_set1_epi8(lower);
+        const __m128i uppers = _mm_set1_epi8(upper);
+        for (; end - p >= 16; p += 16) {
+            __m128i block =
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(block, lowers),
+                                       _mm_cmpeq_epi8(block, uppers));
+            unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(hit));
+            if (mask != 0) {
+                return p + __builtin_ctz(mask);
+            }
+        }
+#endif
+        for (; p < end; ++p) {
+            if (*p == lower || *p == upper) {
+                return p;
+            }
+        }
+        return end;
+    }
+
+    // Whether `word[at]` starts a segment: after a separator, or an upper
+    // case letter following a lower case one (camelCase)
+    bool startsSegment(std::string_view word, size_t at) {
+        char previous = word[at - 1];
+        if (!isLetter(previous) && !isDigit(previous)) {
+            return true;
+        }
+        return isUpper(word[at]) && !isUpper(previous);
+    }
+} // namespace
+
+namespace lsp {
+
+    uint32_t charBag(std::string_view text) {
+        uint32_t bag = 0;
+        for (char c : text) {
+            bag |= bagBit(c);
+        }
+        return bag;
+    }
+
+    void filterByBag(const uint32_t* bags, size_t count, uint32_t needed,
+                     std::vector<uint32_t>& out) {
+        size_t i = 0;
+#if defined(__SSE2__)
+        const __m128i need = _mm_set1_epi32(static_cast<int>(needed));
+        for (; count - i >= 4; i += 4) {
+            __m128i block =
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(bags + i));
+            __m128i hit = _mm_cmpeq_epi32(_mm_and_si128(block, need), need);
+            unsigned mask = static_cast<unsigned>(
+                _mm_movemask_ps(_mm_castsi128_ps(hit)));
+            while (mask != 0) {
+                out.push_back(static_cast<uint32_t>(i + __builtin_ctz(mask)));
+                mask &= mask - 1;
+            }
+        }
+#endif
+        for (; i < count; ++i) {
+            if ((bags[i] & needed) == needed) {
+                out.push_back(static_cast<uint32_t>(i));
+            }
+        }
+    }
+
+    int fuzzyScore(std::string_view pattern, std::string_view word) {
+        const char* begin = word.data();
+        const char* end = begin + word.size();
+        const char* p = begin;
+        int score = 0;
+        size_t previous = 0;
+        for (size_t i = 0; i < pattern.size(); ++i) {
+            char wanted = pattern[i];
+            char lower = foldCase(wanted);
+            char upper = isLetter(lower) ? static_cast<char>(lower & ~0x20)
+                                         : lower;
+            const char* hit = findFolded(p, end, lower, upper);
+            if (hit == end) {
+                return -1;
+            }
+            size_t at = static_cast<size_t>(hit - begin);
+
+            score += 1;
+            if (at == 0) {
+                score += 8;
+            } else if (startsSegment(word, at)) {
+                score += 6;
+            }
+            if (i > 0 && at == previous + 1) {
+                score += 4;
+            }
+            if (*hit == wanted) {
+                score += 1;
+            }
+            if (i == 0) {
+                score -= static_cast<int>(at < 3 ? at : 3);
+            }
+            previous = at;
+            p = hit + 1;
+        }
+        return score;
+    }
+} // namespace lsp
@@ -0,0 +1,437 @@
+#include "JsonReader.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+namespace {
+
+    bool isSpace(char c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+    }
+
+    int hexValue(char c) {
+        if (c >= '0' && c <= '9') {
+            return c - '0';
+        }
+        if (c >= 'a' && c <= 'f') {
+            return c - 'a' + 10;
+        }
+        if (c >= 'A' && c <= 'F') {
+            return c - 'A' + 10;
+        }
+        return -1;
+    }
+
+    // Four hex digits of a \u escape
+    bool readHex4(const char*& p, const char* end, uint32_t& out) {
+        if (end - p < 4) {
+            return false;
+        }
+        out = 0;
+        for (int i = 0; i < 4; ++i) {
+            int digit = hexValue(p[i]);
+            if (digit < 0) {
+                return false;
+            }
+            out = (out << 4) | static_cast<uint32_t>(digit);
+        }
+        p += 4;
+        return true;
+    }
+
+    // First `c` in [p, end), or end
+    const char* findByte(const char* p, const char* end, char c) {
+        if (p >= end) {
+            return end;
+        }
+        const void* hit = std::memchr(p, c, static_cast<size_t>(end - p));
+        return hit != nullptr ? static_cast<const char*>(hit) : end;
+    }
+
+    char* appendUtf8(char* out, uint32_t code) {
+        if (code < 0x80) {
+            *out++ = static_cast<char>(code);
+        } else if (code < 0x800) {
+            *out++ = static_cast<char>(0xC0 | (code >> 6));
+            *out++ = static_cast<char>(0x80 | (code & 0x3F));
+        } else if (code < 0x10000) {
+            *out++ = static_cast<char>(0xE0 | (code >> 12));
+            *out++ = static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            *out++ = static_cast<char>(0x80 | (code & 0x3F));
+        } else {
+            *out++ = static_cast<char>(0xF0 | (code >> 18));
+            *out++ = static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+            *out++ = static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            *out++ = static_cast<char>(0x80 | (code & 0x3F));
+        }
+        return out;
+    }
+
+    // Decodes the escape after a backslash at `p`, which is left past it.
+    // An escape never decodes to more bytes than it takes up. Returns the
+    // new end of `out`, or null for an invalid escape.
+    char* unescape(const char*& p, const char* end, char* out) {
+        if (p == end) {
+            return nullptr;
+        }
+        switch (*p++) {
+        case '"':
+            *out++ = '"';
+            return out;
+        case '\\':
+            *out++ = '\\';
+            return out;
+        case '/':
+            *out++ = '/';
+            return out;
+        case 'b':
+            *out++ = '\b';
+            return out;
+        case 'f':
+            *out++ = '\f';
+            return out;
+        case 'n':
+            *out++ = '\n';
+            return out;
+        case 'r':
+            *out++ = '\r';
+            return out;
+        case 't':
+            *out++ = '\t';
+            return out;
+        case 'u': {
+            uint32_t code;
+            if (!readHex4(p, end, code)) {
+                return nullptr;
+            }
+            if (code >= 0xD800 && code < 0xDC00) {
+                // High surrogate; the low half must follow
+                uint32_t low;
+                if (end - p < 2 || p[0] != '\\' || p[1] != 'u') {
+                    return nullptr;
+                }
+                p += 2;
+                if (!readHex4(p, end, low) || low < 0xDC00 || low > 0xDFFF) {
+                    return nullptr;
+                }
+                code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+            } else if (code >= 0xDC00 && code <= 0xDFFF) {
+                return nullptr;
+            }
+            return appendUtf8(out, code);
+        }
+        default:
+            return nullptr;
+        }
+    }
+
+    // Unescapes the body of a string, [p, close), into `out`, which must
+    // have room for close - p bytes. Returns the end of the output, or null
+    // on an invalid escape.
+    char* decodeString(const char* p, const char* close, char* out) {
+        while (true) {
+            const char* backslash = findByte(p, close, '\\');
+            std::memcpy(out, p, static_cast<size_t>(backslash - p));
+            out += backslash - p;
+            if (backslash == close) {
+                return out;
+            }
+            p = backslash + 1;
+            out = unescape(p, close, out);
+            if (out == nullptr) {
+                return nullptr;
+            }
+        }
+    }
+} // namespace
+
+namespace lsp {
+
+    const char* skipJsonString(const char* p, const char* end,
+                               bool& escaped) {
+        ++p;
+        escaped = false;
+        while (p < end) {
+            const void* hit = std::memchr(p, '"', end - p);
+            if (hit == nullptr) {
+                return nullptr;
+            }
+            const char* quote = static_cast<const char*>(hit);
+            // The quote is escaped if preceded by an odd number of
+            // backslashes
+            size_t backslashes = 0;
+            while (quote - backslashes > p && quote[-1 - backslashes] == '\\') {
+                ++backslashes;
+            }
+            if (!escaped && std::find(p, quote, '\\') != quote) {
+                escaped = true;
+            }
+            p = quote + 1;
+            if (backslashes % 2 == 0) {
+                return p;
+            }
+        }
+        return nullptr;
+    }
+
+    const char* skipJsonValue(const char* p, const char* end) {
+        bool escaped;
+        if (*p == '"') {
+            return skipJsonString(p, end, escaped);
+        }
+        if (*p != '{' && *p != '[') {
+            // Number or literal
+            while (p < end && *p != ',' && *p != '}' && *p != ']' &&
+                   !isSpace(*p)) {
+                ++p;
+            }
+            return p;
+        }
+
+        size_t depth = 0;
+        while (p < end) {
+            switch (*p) {
+            case '"':
+                p = skipJsonString(p, end, escaped);
+                if (p == nullptr) {
+                    return nullptr;
+                }
+                continue;
+            case '{':
+            case '[':
+                ++depth;
+                break;
+            case '}':
+            case ']':
+                if (--depth == 0) {
+                    return p + 1;
+                }
+                break;
+            default:
+                break;
+            }
+            ++p;
+        }
+        return nullptr;
+    }
+
+    void JsonReader::skipSpace() {
+        while (p < end && isSpace(*p)) {
+            ++p;
+        }
+    }
+
+    bool JsonReader::expect(char c) {
+        skipSpace();
+        if (failed || p == end || *p != c) {
+            return fail();
+        }
+        ++p;
+        return true;
+    }
+
+    char JsonReader::peek() {
+        skipSpace();
+        return failed || p == end ? '\0' : *p;
+    }
+
+    bool JsonReader::beginObject() {
+        first = true;
+        return expect('{');
+    }
+
+    bool JsonReader::nextMember(std::string_view& key) {
+        char c = peek();
+        if (c == '}') {
+            ++p;
+            first = false;
+            return false;
+        }
+        if (!first && !expect(',')) {
+            return false;
+        }
+        first = false;
+        if (!readString(key, keyStorage)) {
+            return false;
+        }
+        return expect(':');
+    }
+
+    bool JsonReader::beginArray() {
+        first = true;
+        return expect('[');
+    }
+
+    bool JsonReader::nextElement() {
+        char c = peek();
+        if (c == ']') {
+            ++p;
+            first = false;
+            return false;
+        }
+        if (!first && !expect(',')) {
+            return false;
+        }
+        first = false;
+        return !failed;
+    }
+
+    bool JsonReader::readString(std::string& out) {
+        std::string_view body;
+        bool escaped;
+        if (!scanString(body, escaped)) {
+            return false;
+        }
+        out.resize(body.size());
+        if (!escaped) {
+            std::memcpy(out.data(), body.data(), body.size());
+            return true;
+        }
+        char* outEnd = decodeString(body.data(), body.data() + body.size(),
+                                    out.data());
+        if (outEnd == nullptr) {
+            return fail();
+        }
+        out.resize(static_cast<size_t>(outEnd - out.data()));
+        return true;
+    }
+
+    bool JsonReader::readString(std::string_view& out,
+                                std::string& storage) {
+        std::string_view body;
+        bool escaped;
+        if (!scanString(body, escaped)) {
+            return false;
+        }
+        if (!escaped) {
+            out = body;
+            return true;
+        }
+        storage.resize(body.size());
+        char* outEnd = decodeString(body.data(), body.data() + body.size(),
+                                    storage.data());
+        if (outEnd == nullptr) {
+            return fail();
+        }
+        out = std::string_view(storage.data(),
+                               static_cast<size_t>(outEnd - storage.data()));
+        return true;
+    }
+
+    bool JsonReader::readString(std::string_view& out) {
+        if (arena == nullptr) {
+            return fail();
+        }
+        std::string_view body;
+        bool escaped;
+        if (!scanString(body, escaped)) {
+            return false;
+        }
+        if (!escaped) {
+            out = arena->copy(body);
+            return true;
+        }
+        // Unescaping only shrinks, so the raw size is enough room
+        char* data = arena->allocateArray<char>(body.size());
+        char* outEnd =
+            decodeString(body.data(), body.data() + body.size(), data);
+        if (outEnd == nullptr) {
+            return fail();
+        }
+        out = std::string_view(data, static_cast<size_t>(outEnd - data));
+        return true;
+    }
+
+    bool JsonReader::scanString(std::string_view& body, bool& escaped) {
+        if (peek() != '"') {
+            return fail();
+        }
+        const char* close = skipJsonString(p, end, escaped);
+        if (close == nullptr) {
+            return fail();
+        }
+        body = std::string_view(p + 1, static_cast<size_t>(close - p - 2));
+        p = close;
+        return true;
+    }
+
+    bool JsonReader::readInteger(int64_t& out) {
+        skipSpace();
+        if (failed) {
+            return false;
+        }
+        auto result = std::from_chars(p, end, out);
+        if (result.ec != std::errc() ||
+            (result.ptr < end && (*result.ptr == '.' || *result.ptr == 'e' ||
+                                  *result.ptr == 'E'))) {
+            return fail();
+        }
+        p = result.ptr;
+        return true;
+    }
+
+    bool JsonReader::readDouble(double& out) {
+        skipSpace();
+        if (failed) {
+            return false;
+        }
+        auto result = std::from_chars(p, end, out);
+        if (result.ec != std::errc()) {
+            return fail();
+        }
+        p = result.ptr;
+        return true;
+    }
+
+    bool JsonReader::readBool(bool& out) {
+        skipSpace();
+        if (failed) {
+            return false;
+        }
+        std::string_view rest(p, end - p);
+        if (rest.starts_with("true")) {
+            out = true;
+            p += 4;
+            return true;
+        }
+        if (rest.starts_with("false")) {
+            out = false;
+            p += 5;
+            return true;
+        }
+        return fail();
+    }
+
+    bool JsonReader::readNull() {
+        skipSpace();
+        if (failed || !std::string_view(p, end - p).starts_with("null")) {
+            return false;
+        }
+        p += 4;
+        return true;
+    }
+
+    bool JsonReader::readRaw(std::string_view& out) {
+        skipSpace();
+        if (failed || p == end) {
+            return fail();
+        }
+        const char* valueEnd = skipJsonValue(p, end);
+        if (valueEnd == nullptr || valueEnd == p) {
+            return fail();
+        }
+        out = std::string_view(p, valueEnd - p);
+        p = valueEnd;
+        return true;
+    }
+
+    bool JsonReader::skipValue() {
+        std::string_view ignored;
+        return readRaw(ignored);
+    }
+
+    bool JsonReader::atEnd() {
+        skipSpace();
+        return !failed && p == end;
+    }
+} // namespace lsp
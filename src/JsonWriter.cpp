@@ -0,0 +1,234 @@
+#include "JsonWriter.h"
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+    bool needsEscape(char c) {
+        return static_cast<unsigned char>(c) < 0x20 || c == '"' || c == '\\';
+    }
+
+    // First byte in [p, end) that can't be copied into a JSON string as is
+    const char* findEscape(const char* p, const char* end) {
+#if defined(__SSE2__)
+        // Quotes, backslashes and control characters, 16 bytes at a time.
+        // There is no unsigned compare, so `c <= 0x1F` is min(c, 0x1F) == c.
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i backslash = _mm_set1_epi8('\\');
+        const __m128i control = _mm_set1_epi8(0x1F);
+        for (; end - p >= 16; p += 16) {
+            __m128i block =
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            __m128i special = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(block, quote),
+                             _mm_cmpeq_epi8(block, backslash)),
+                _mm_cmpeq_epi8(_mm_min_epu8(block, control), block));
+            unsigned mask =
+                static_cast<unsigned>(_mm_movemask_epi8(special));
+            if (mask != 0) {
+                return p + __builtin_ctz(mask);
+            }
+        }
+#endif
+        for (; p < end; ++p) {
+            if (needsEscape(*p)) {
+                return p;
+            }
+        }
+        return end;
+    }
+
+    // Same escapes as nlohmann's dump(), so both writers agree byte for byte
+    void appendEscape(std::string& out, char c) {
+        switch (c) {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\b':
+            out += "\\b";
+            break;
+        case '\f':
+            out += "\\f";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        case '\r':
+            out += "\\r";
+            break;
+        case '\t':
+            out += "\\t";
+            break;
+        default: {
+            static constexpr char HEX[] = "0123456789abcdef";
+            auto byte = static_cast<unsigned char>(c);
+            char escape[] = {'\\', 'u', '0', '0', HEX[byte >> 4],
+                             HEX[byte & 0xF]};
+            out.append(escape, sizeof escape);
+            break;
+        }
+        }
+    }
+
+    constexpr std::string_view CONTENT_LENGTH = "Content-Length: ";
+} // namespace
+
+namespace lsp {
+
+    JsonWriter::JsonWriter(size_t capacity) {
+        buffer.reserve(HEADER_SPACE + capacity);
+        buffer.resize(HEADER_SPACE);
+    }
+
+    void JsonWriter::separate() {
+        if (afterKey) {
+            afterKey = false;
+            return;
+        }
+        uint64_t bit = uint64_t{1} << depth;
+        if ((hasItems & bit) != 0) {
+            buffer += ',';
+        }
+        hasItems |= bit;
+    }
+
+    void JsonWriter::begin(char bracket) {
+        separate();
+        buffer += bracket;
+        ++depth;
+        hasItems &= ~(uint64_t{1} << depth);
+    }
+
+    void JsonWriter::end(char bracket) {
+        --depth;
+        buffer += bracket;
+    }
+
+    void JsonWriter::beginObject() {
+        begin('{');
+    }
+
+    void JsonWriter::endObject() {
+        end('}');
+    }
+
+    void JsonWriter::beginArray() {
+        begin('[');
+    }
+
+    void JsonWriter::endArray() {
+        end(']');
+    }
+
+    void JsonWriter::key(std::string_view name) {
+        separate();
+        writeString(name);
+        buffer += ':';
+        afterKey = true;
+    }
+
+    void JsonWriter::value(std::string_view text) {
+        separate();
+        writeString(text);
+    }
+
+    void JsonWriter::value(bool flag) {
+        separate();
+        buffer += flag ? "true" : "false";
+    }
+
+    void JsonWriter::value(std::nullptr_t) {
+        separate();
+        buffer += "null";
+    }
+
+    void JsonWriter::value(double number) {
+        separate();
+        if (!std::isfinite(number)) {
+            buffer += "null";
+            return;
+        }
+        char digits[32];
+        auto result = std::to_chars(digits, digits + sizeof digits, number);
+        std::string_view text(digits, result.ptr - digits);
+        buffer += text;
+        // Keep doubles recognizable as such, as dump() does
+        if (text.find_first_of(".e") == std::string_view::npos) {
+            buffer += ".0";
+        }
+    }
+
+    void JsonWriter::value(const json& node) {
+        separate();
+        // Serialize in place rather than through a temporary string
+        nlohmann::detail::serializer<json> serializer(
+            nlohmann::detail::output_adapter<char, std::string>(buffer), ' ');
+        serializer.dump(node, false, false, 0);
+    }
+
+    void JsonWriter::raw(std::string_view encoded) {
+        separate();
+        buffer += encoded;
+    }
+
+    void JsonWriter::rawMembers(std::string_view encoded) {
+        if (encoded.empty()) {
+            return;
+        }
+        separate();
+        buffer += encoded;
+    }
+
+    void JsonWriter::writeString(std::string_view text) {
+        buffer += '"';
+        const char* p = text.data();
+        const char* end = p + text.size();
+        while (true) {
+            const char* special = findEscape(p, end);
+            buffer.append(p, special - p);
+            if (special == end) {
+                break;
+            }
+            appendEscape(buffer, *special);
+            p = special + 1;
+        }
+        buffer += '"';
+    }
+
+    void JsonWriter::writeInteger(int64_t number) {
+        separate();
+        char digits[24];
+        auto result = std::to_chars(digits, digits + sizeof digits, number);
+        buffer.append(digits, result.ptr - digits);
+    }
+
+    void JsonWriter::writeUnsigned(uint64_t number) {
+        separate();
+        char digits[24];
+        auto result = std::to_chars(digits, digits + sizeof digits, number);
+        buffer.append(digits, result.ptr - digits);
+    }
+
+    size_t JsonWriter::finishFrame() {
+        char length[24];
+        auto result = std::to_chars(length, length + sizeof length,
+                                    buffer.size() - HEADER_SPACE);
+        size_t digits = static_cast<size_t>(result.ptr - length);
+        size_t start = HEADER_SPACE - CONTENT_LENGTH.size() - digits - 4;
+
+        char* header = buffer.data() + start;
+        std::memcpy(header, CONTENT_LENGTH.data(), CONTENT_LENGTH.size());
+        header += CONTENT_LENGTH.size();
+        std::memcpy(header, length, digits);
+        std::memcpy(header + digits, "\r\n\r\n", 4);
+        return start;
+    }
+} // namespace lsp
@@ -1,402 +1,795 @@
 #include "LSPServer.h"
-#include <iostream>
-#include <regex>
+#include "Analysis.h"
+#include "Logger.h"
+#include "MessageDecoder.h"
+#include "MessageReader.h"
+#include "ProtocolCodec.h"
+#include <mutex>
+#include <unistd.h>
 #include <utility>
 
-size_t positionToOffset(const std::string& content, int line, int character) {
-        int currentLine = 0;
-        int currentChar = 0;
-        for (size_t i = 0; i < content.length(); ++i) {
-            if (currentLine == line && currentChar == character) {
-                return i;
-            }
-            if (content[i] == '\n') {
-                currentLine++;
-                currentChar = 0;
-            } else {
-                currentChar++;
-            }
+namespace lsp {
+
+    // Stats of whatever the current thread is handling, so sendResponse can
+    // attribute serialization time to it
+    thread_local MethodStats* currentStats = nullptr;
+
+    // Log level for an LSP TraceValue ("off", "messages" or "verbose")
+    static LogLevel levelForTrace(std::string_view trace) {
+        if (trace == "verbose") {
+            return LogLevel::Debug;
+        }
+        if (trace == "messages") {
+            return LogLevel::Info;
         }
-        return content.length(); // Return end of file if not found
+        return LogLevel::Warn;
     }
 
-std::string getWordAt(const std::string& content, int line, int character) {
-    if (content.empty()) return "";
+    // Lint rule setting from initializationOptions.lint: true for the
+    // rule's default, false or "off" to turn it off, or a severity name.
+    // Returns false if the value is none of these.
+    static bool lintLevel(const json& value, DiagnosticSeverity fallback,
+                          std::optional<DiagnosticSeverity>& level) {
+        if (value.is_boolean()) {
+            level = value.get<bool>() ? std::optional{fallback} : std::nullopt;
+            return true;
+        }
+        if (!value.is_string()) {
+            return false;
+        }
+        const std::string& name = value.get_ref<const std::string&>();
+        if (name == "off") {
+            level = std::nullopt;
+        } else if (name == "error") {
+            level = DiagnosticSeverity::Error;
+        } else if (name == "warning") {
+            level = DiagnosticSeverity::Warning;
+        } else if (name == "information") {
+            level = DiagnosticSeverity::Information;
+        } else if (name == "hint") {
+            level = DiagnosticSeverity::Hint;
+        } else {
+            return false;
+        }
+        return true;
+    }
 
-    size_t offset = positionToOffset(content, line, character);
+    template <typename Result>
+    void Server::sendResult(const json& id, const Result& result) {
+        auto start = StatsClock::now();
+        JsonWriter out;
+        out.beginObject();
+        out.field("jsonrpc", "2.0");
+        out.field("id", id);
+        out.key("result");
+        writeJson(out, result);
+        out.endObject();
+        sendFrame(out, start);
+    }
 
-    size_t start = offset, end = offset;
-    while (start > 0 && std::isalnum(content[start - 1])) start--;
-    while (end < content.size() && std::isalnum(content[end])) end++;
-    
-    if (start >= end) return "";
-    return content.substr(start, end - start);
-}
+    template <typename Params>
+    void Server::sendNotification(std::string_view method,
+                                  const Params& params) {
+        auto start = StatsClock::now();
+        JsonWriter out;
+        out.beginObject();
+        out.field("jsonrpc", "2.0");
+        out.field("method", method);
+        out.key("params");
+        writeJson(out, params);
+        out.endObject();
+        sendFrame(out, start);
+    }
 
-namespace lsp {
+    struct MethodBinder;
+    struct MethodRegistry;
 
-    Server::Server() {
-        std::cerr << "LSP Server initialized" << std::endl;
+    Server::Server()
+        : writer(STDOUT_FILENO), stats(methodCount()),
+          diagnostics([this](const std::string& uri, int version,
+                             DiagnosticsScheduler::CancelFlag cancelled) {
+              launchValidation(uri, version, std::move(cancelled));
+          }) {
+        LSP_LOG(Info, "Server") << "LSP Server initialized";
     }
 
     Server::~Server() {
-        // std::cerr << "LSP Server shutting down." << std::endl;
+        // Pending diagnostics feed the scheduler, so stop them first
+        diagnostics.shutdown();
+        scheduler.shutdown();
     }
 
-    void Server::run() {
+    void Server::run(const std::string& recordPath) {
+        if (!recordPath.empty()) {
+            recorder = std::make_unique<TraceRecorder>(recordPath);
+            LSP_LOG(Info, "Server") << "Recording session to " << recordPath;
+        }
+
         // Start the server and listen for incoming requests
+        MessageReader reader(STDIN_FILENO);
+
+        // Each body is a view into the reader's buffer and is only valid
+        // until the next message is read
+        while (auto body = reader.next()) {
+            stats.messagesRead.fetch_add(1, std::memory_order_relaxed);
+            stats.bytesRead.store(reader.bytesRead(), std::memory_order_relaxed);
+            if (recorder) {
+                recorder->record(TraceDirection::Inbound, *body);
+            }
+            parseMessage(*body);
+        }
+
+        // Finish queued work before the writer is torn down
+        diagnostics.shutdown();
+        scheduler.shutdown();
+        if (recorder) {
+            recorder->close();
+        }
+
+        LSP_LOG(Info, "Stats") << collectStats().dump(2);
+        Logger::instance().flush();
+    }
 
-        while (true) {
-            // Read the "Content-Length" header
-            std::string contentLengthHeader;
-            std::getline(std::cin, contentLengthHeader);
-            if (contentLengthHeader.empty()) {
-                // End of stream or client closed connection
-                break;
+    // Decodes the raw params of a message into its method's params struct.
+    // Strings and lists land in the request's arena, not on the heap.
+    template <typename Params>
+    bool decodeInto(std::string_view raw, Request& request) {
+        return decodeJson(raw, request.params.emplace<Params>(),
+                          *request.arena);
+    }
+
+    template <typename Handler> struct HandlerTraits;
+    template <typename Params>
+    struct HandlerTraits<void (Server::*)(const Request&, const Params&)> {
+        using ParamsType = Params;
+    };
+
+    // Builds a registry entry for a typed handler: its params decoder and
+    // dispatch thunk are generated from the handler's signature
+    struct MethodBinder {
+        template <auto Handler>
+        static constexpr MethodInfo bind(std::string_view name,
+                                         MethodKind kind, bool cancellable,
+                                         Priority priority, bool sequential,
+                                         bool needsSnapshot) {
+            using Params =
+                typename HandlerTraits<decltype(Handler)>::ParamsType;
+            return {name,
+                    &Server::invoke<Params, Handler>,
+                    kind,
+                    cancellable,
+                    priority,
+                    sequential,
+                    needsSnapshot,
+                    &decodeInto<Params>};
+        }
+    };
+
+    // Every LSP method the server handles. Adding a method means adding its
+    // handler, its params type to MethodParams and one entry here.
+    struct MethodRegistry : MethodBinder {
+        static constexpr MethodInfo methods[] = {
+            bind<&Server::onInitialize>("initialize", MethodKind::Request,
+                                        false, Priority::High, true, false),
+            bind<&Server::onDidOpen>("textDocument/didOpen",
+                                     MethodKind::Notification, false,
+                                     Priority::High, true, false),
+            bind<&Server::onDidChangeContent>("textDocument/didChange",
+                                              MethodKind::Notification, false,
+                                              Priority::High, true, false),
+            bind<&Server::onDidSave>("textDocument/didSave",
+                                     MethodKind::Notification, false,
+                                     Priority::High, true, false),
+            bind<&Server::onDidClose>("textDocument/didClose",
+                                      MethodKind::Notification, false,
+                                      Priority::High, true, false),
+            bind<&Server::onCompletion>("textDocument/completion",
+                                        MethodKind::Request, true,
+                                        Priority::Normal, false, true),
+            bind<&Server::onCompletionResolve>("completionItem/resolve",
+                                               MethodKind::Request, true,
+                                               Priority::Normal, false, false),
+            bind<&Server::onHover>("textDocument/hover", MethodKind::Request,
+                                   true, Priority::Normal, false, true),
+            // Answers with an empty report for documents that aren't open,
+            // so it looks the document up itself
+            bind<&Server::onDocumentDiagnostic>("textDocument/diagnostic",
+                                                MethodKind::Request, true,
+                                                Priority::Normal, false, false),
+            bind<&Server::onSetTrace>("$/setTrace", MethodKind::Notification,
+                                      false, Priority::Immediate, false,
+                                      false),
+            bind<&Server::onCancelRequest>("$/cancelRequest",
+                                           MethodKind::Notification, false,
+                                           Priority::Immediate, false, false),
+            bind<&Server::onStats>("$/swirl/stats", MethodKind::Request, false,
+                                   Priority::High, false, false),
+        };
+
+        static constexpr auto table = makeMethodTable(methods);
+    };
+
+    size_t Server::methodCount() {
+        return MethodRegistry::table.size();
+    }
+
+    struct ReleaseRequest {
+        Server* server;
+        void operator()(Request* request) const {
+            server->releaseRequest(request);
+        }
+    };
+
+    void Server::parseMessage(std::string_view jsonContent) {
+        try {
+            // Only the envelope is looked at before routing; params are
+            // decoded once we know which method they belong to
+            Envelope envelope;
+            if (!scanEnvelope(jsonContent, envelope)) {
+                LSP_LOG(Error, "Parse") << "Malformed message envelope";
+                return;
+            }
+            if (envelope.method.empty()) {
+                // Responses to server requests; we send none
+                return;
             }
 
-            int contentLength = 0;
-            try {
-                contentLength = std::stoi(contentLengthHeader.substr(16));
-            } catch (const std::exception& e) {
-                // Log an error
-                continue;
+            LSP_LOG(Debug, "Received Request") << envelope.method;
+
+            // The request and everything decoded for it share one arena,
+            // released in a single step once the handler is done
+            Arena* arena = arenas.acquire();
+            std::unique_ptr<Request, ReleaseRequest> owner(
+                arena->create<Request>(), ReleaseRequest{this});
+            Request& request = *owner;
+            request.arena = arena;
+            request.hasId = !envelope.id.empty();
+            if (request.hasId) {
+                request.id = json::parse(envelope.id);
             }
 
-            // Read the mandatory blank line after the header
-            std::string blankLine;
-            std::getline(std::cin, blankLine);
+            const MethodInfo* info = MethodRegistry::table.find(envelope.method);
+            if (info == nullptr) {
+                // Unknown requests get an error, unknown notifications are
+                // dropped as the spec requires
+                if (request.hasId) {
+                    sendError(request.id, ErrorCode::MethodNotFound,
+                              "Method not found: " +
+                                  std::string(envelope.method));
+                }
+                return;
+            }
+            request.method = info;
+            request.received = StatsClock::now();
+
+            // One validating pass straight into the params struct; a
+            // handler never sees missing or mistyped fields
+            if (!info->decode(envelope.params, request)) {
+                LSP_LOG(Error, "Parse") << "Invalid params for " << info->name;
+                if (request.hasId) {
+                    sendError(request.id, ErrorCode::InvalidParams,
+                              "Invalid params");
+                }
+                return;
+            }
 
-            // Read the JSON content itself
-            std::vector<char> jsonBuffer(contentLength);
-            std::cin.read(jsonBuffer.data(), contentLength);
-            std::string jsonContent(jsonBuffer.begin(), jsonBuffer.end());
+            if (info->cancellable && request.hasId) {
+                request.cancelled = std::make_shared<std::atomic<bool>>(false);
+                std::lock_guard lock(inflightMutex);
+                inflight[request.id.dump()] = request.cancelled;
+            }
 
-            // Parse and process the message
-            parseMessage(jsonContent);
+            if (info->priority == Priority::Immediate) {
+                dispatch(request);
+                return;
+            }
+            // Scheduled tasks always run, so the task takes over the request
+            scheduler.submit({[this, request = owner.release()] {
+                                  dispatch(*request);
+                                  releaseRequest(request);
+                              },
+                              info->priority, info->sequential, false});
+        } catch (const json::exception& e) {
+            // Log JSON parsing error
+            LSP_LOG(Error, "Parse") << "JSON parse error: " << e.what();
         }
     }
 
-    void Server::parseMessage(const std::string& jsonContent) {
-        try {
-            json request = json::parse(jsonContent);
-            if (request.contains("method")) {
-                std::string method = request["method"];
-
-                std::cerr << "[Received Request] " << method
-                          << std::endl;
-
-                if (method == "initialize") {
-                    // Handle the "initialize" request
-                    onInitialize(request);
-                } else if (method == "textDocument/didChange") {
-                    // Handle the "didChangeContent" notification
-                    onDidChangeContent(request);
-                } else if (method == "textDocument/didOpen") {
-                    onDidOpen(request);
-                } else if (method == "textDocument/didSave") {
-                    // Handle the "didSave" notification
-                    std::cerr << "[Did Save] "
-                              << request["params"]["textDocument"]["uri"]
-                              << std::endl;
-                    // Here you would typically save the document state
-                } else if (method == "textDocument/completion") {
-                    // Handle the "completion" request
-                    onCompletion(request);
-                } else if (method == "completionItem/resolve") {
-                    // Handle the "completionResolve" request
-                    onCompletionResolve(request);
-                } else if (method == "textDocument/hover") {
-                    // Handle the "hover" request
-                    onHover(request);
-                    std::cerr << "[Hover] "
-                              << request["params"]["textDocument"]["uri"]
-                              << std::endl;
-                } else if (method == "$/setTrace") {
-                    // Handle the "setTrace" request
-                    onSetTrace(request);
+    void Server::releaseRequest(Request* request) {
+        Arena* arena = request->arena;
+        std::destroy_at(request);
+        arenas.release(arena);
+    }
+
+    // URI of the document a method's params refer to, if they name one
+    static std::optional<std::string_view>
+    documentUri(const MethodParams& params) {
+        return std::visit(
+            [](const auto& p) -> std::optional<std::string_view> {
+                if constexpr (requires { p.textDocument.uri; }) {
+                    return std::string_view(p.textDocument.uri);
                 } else {
-                    // Handle other methods or send an error response
-                    json errorResponse = {
-                        {"jsonrpc", "2.0"},
-                        {"id", 1},
-                        {"result", nullptr},
-                        {"error",
-                         {{"code", -32601}, // Method not found
-                          {"message", "Method not found: " + method}}}};
-                    sendResponse(errorResponse);
+                    return std::nullopt;
                 }
+            },
+            params);
+    }
+
+    void Server::dispatch(Request& request) {
+        const MethodInfo& info = *request.method;
+        bool isRequest = info.kind == MethodKind::Request && request.hasId;
+
+        MethodStats& methodStats =
+            stats.method(MethodRegistry::table.indexOf(&info));
+        methodStats.queueWait.record(elapsedNanoseconds(request.received));
+        currentStats = &methodStats;
+        auto start = StatsClock::now();
+
+        try {
+            request.checkCancelled();
+            // Taken here rather than on arrival, so edits queued ahead of
+            // the request are already applied
+            if (info.needsSnapshot) {
+                std::optional<std::string_view> uri =
+                    documentUri(request.params);
+                request.document = uri ? getDocument(*uri) : nullptr;
+            }
+            if (info.needsSnapshot && !request.document) {
+                LSP_LOG(Debug, "Dispatch")
+                    << info.name << ": document is not open";
+                if (isRequest) {
+                    sendResult(request.id, json(nullptr));
+                }
+            } else {
+                (this->*info.handler)(request);
+            }
+        } catch (const RequestCancelled&) {
+            if (isRequest) {
+                sendError(request.id, ErrorCode::RequestCancelled,
+                          "Request cancelled");
+            }
+        } catch (const std::exception& e) {
+            LSP_LOG(Error, "Handler Error") << info.name << ": " << e.what();
+            if (isRequest) {
+                sendError(request.id, ErrorCode::InternalError,
+                          e.what());
             }
-        } catch (const json::parse_error& e) {
-            // Log JSON parsing error
-            std::cerr << "JSON parse error: " << e.what() << std::endl;
+        }
+
+        methodStats.handler.record(elapsedNanoseconds(start));
+        currentStats = nullptr;
+
+        if (request.cancelled) {
+            std::lock_guard lock(inflightMutex);
+            inflight.erase(request.id.dump());
+        }
+    }
+
+    void Server::onStats(const Request& request, const NoParams&) {
+        // Handle the custom "$/swirl/stats" request
+        sendResult(request.id, collectStats());
+    }
+
+    json Server::collectStats() {
+        json methods = json::object();
+        for (size_t i = 0; i < MethodRegistry::table.size(); ++i) {
+            const MethodStats& method = stats.method(i);
+            if (method.handler.count() == 0) {
+                continue;
+            }
+            methods[std::string(MethodRegistry::table[i].name)] = {
+                {"queueWait", method.queueWait.summary()},
+                {"handler", method.handler.summary()},
+                {"serialize", method.serialize.summary()}};
+        }
+
+        return {{"uptimeMs", elapsedNanoseconds(stats.startTime) / 1000000},
+                {"bytesRead", stats.bytesRead.load(std::memory_order_relaxed)},
+                {"bytesWritten", writer.bytesWritten()},
+                {"messagesRead",
+                 stats.messagesRead.load(std::memory_order_relaxed)},
+                {"messagesWritten",
+                 stats.messagesWritten.load(std::memory_order_relaxed)},
+                {"methods", methods},
+                {"validateDocument",
+                 {{"queueWait", stats.validation.queueWait.summary()},
+                  {"handler", stats.validation.handler.summary()},
+                  {"serialize", stats.validation.serialize.summary()}}}};
+    }
+
+    void Server::onCancelRequest(const Request&, const CancelParams& params) {
+        // Handle the "$/cancelRequest" notification. The handler notices the
+        // flag at its next cancellation point and answers RequestCancelled.
+        std::string id = params.id.dump();
+        std::lock_guard lock(inflightMutex);
+        auto it = inflight.find(id);
+        if (it != inflight.end()) {
+            it->second->store(true, std::memory_order_relaxed);
         }
     }
 
     void Server::sendResponse(const json& response) {
-        std::string responseStr = response.dump();
-        std::cout << "Content-Length: " << responseStr.size() << "\r\n\r\n"
-                  << responseStr;
-        std::cout.flush();
-        // std::cerr << "[Sent Response] " << response.dump(4) << std::endl;
+        auto start = StatsClock::now();
+        JsonWriter out;
+        out.value(response);
+        sendFrame(out, start);
+    }
+
+    void Server::sendError(const json& id, ErrorCode code,
+                           const std::string& message) {
+        auto start = StatsClock::now();
+        JsonWriter out;
+        out.beginObject();
+        out.field("jsonrpc", "2.0");
+        out.field("id", id);
+        out.field("result", nullptr);
+        out.key("error");
+        out.beginObject();
+        out.field("code", static_cast<int>(code));
+        out.field("message", message);
+        out.endObject();
+        out.endObject();
+        sendFrame(out, start);
+    }
+
+    void Server::sendFrame(JsonWriter& out, StatsClock::time_point start) {
+        size_t offset = out.finishFrame();
+        if (currentStats != nullptr) {
+            currentStats->serialize.record(elapsedNanoseconds(start));
+        }
+        stats.messagesWritten.fetch_add(1, std::memory_order_relaxed);
+        if (recorder) {
+            recorder->record(TraceDirection::Outbound, out.body());
+        }
+
+        // The write itself happens on the writer thread
+        writer.sendFrame(out.release(), offset);
     }
 
-    void Server::onInitialize(const json& request) {
+    void Server::onInitialize(const Request& request,
+                              const InitializeParams& params) {
         // Handle the "initialize" request
+        if (params.capabilities && params.capabilities->textDocument &&
+            params.capabilities->textDocument->completion &&
+            params.capabilities->textDocument->completion->completionList) {
+            const CompletionListCapabilities& list =
+                *params.capabilities->textDocument->completion->completionList;
+            if (list.itemDefaults) {
+                for (std::string_view property : *list.itemDefaults) {
+                    if (property == "editRange") {
+                        completions.setDefaultEditRange(true);
+                    }
+                }
+            }
+        }
+        if (params.trace) {
+            Logger::instance().setLevel(levelForTrace(*params.trace));
+        }
+        // initializationOptions is free-form (LSPAny), so it stays json
+        if (params.initializationOptions &&
+            params.initializationOptions->is_object()) {
+            const json& options = *params.initializationOptions;
+            if (options.contains("diagnosticsDelay") &&
+                options["diagnosticsDelay"].is_number_unsigned()) {
+                // Debounce delay for diagnostics after edits, in ms
+                diagnostics.setDelay(std::chrono::milliseconds(
+                    options["diagnosticsDelay"].get<unsigned>()));
+            }
+            if (options.contains("maxCompletionItems") &&
+                options["maxCompletionItems"].is_number_unsigned()) {
+                // Completion results beyond this are cut, isIncomplete set
+                completions.setLimit(
+                    options["maxCompletionItems"].get<size_t>());
+            }
+            if (options.contains("publishUnchangedDiagnostics") &&
+                options["publishUnchangedDiagnostics"].is_boolean()) {
+                // For clients that time every validation by its publish
+                publishUnchanged.store(
+                    options["publishUnchangedDiagnostics"].get<bool>(),
+                    std::memory_order_relaxed);
+            }
+            if (options.contains("lint") && options["lint"].is_object()) {
+                // Rule id: "off", a severity name, or true/false
+                const LintEngine& engine = lintEngine();
+                for (const auto& [id, value] : options["lint"].items()) {
+                    std::optional<size_t> rule = engine.find(id);
+                    std::optional<DiagnosticSeverity> level;
+                    if (!rule) {
+                        LSP_LOG(Warn, "Server") << "Unknown lint rule " << id;
+                    } else if (!lintLevel(value, engine.rule(*rule).severity,
+                                          level)) {
+                        LSP_LOG(Warn, "Server")
+                            << "Invalid setting for lint rule " << id;
+                    } else {
+                        lintSettings.set(id, level);
+                    }
+                }
+            }
+        }
+
         json response = {{"jsonrpc", "2.0"},
-                         {"id", request["id"]},
+                         {"id", request.id},
                          {"result",
                           {{"capabilities",
                             {// Advertise the features your server supports
-                             {"textDocumentSync", 1}, // 1 = Full sync
+                             {"textDocumentSync", 2}, // 2 = Incremental
                              {"completionProvider",
                               {{"resolveProvider", true},
                                {"triggerCharacters", {".", "@"}}}},
-                             {"diagnosticsProvider",
-                              {{"interFileDependencies", true},
-                               {"workspaceDiagnostics", true}}},
+                             {"diagnosticProvider",
+                              {{"interFileDependencies", false},
+                               {"workspaceDiagnostics", false}}},
                              {"hoverProvider", true}}}}}};
         sendResponse(response);
     }
 
-    void Server::onDidOpen(const json& request) {
+    void Server::onDidOpen(const Request&,
+                           const DidOpenTextDocumentParams& params) {
         // Handle the "didOpen" notification
-        if (request.contains("params") &&
-            request["params"].contains("textDocument")) {
-            std::string uri = request["params"]["textDocument"]["uri"];
-            std::string text = request["params"]["textDocument"]["text"];
-            int version = request["params"]["textDocument"]["version"];
+        const TextDocumentItem& document = params.textDocument;
+
+        // Store the document
+        storeDocument(document.uri, document.text, document.version);
+        // A reopened document may start its versions over, and its
+        // diagnostics were cleared on close
+        {
+            std::lock_guard lock(publishMutex);
+            published.forget(document.uri);
+        }
+
+        // Validate the document off the ordered lane
+        scheduleValidation(document.uri, document.version, true);
 
-            // Store the document
-            storeDocument(uri, text, version);
+        LSP_LOG(Debug, "Did Open")
+            << document.uri << " (length: " << document.text.length() << ")";
+    }
 
-            // Validate the document
-            validateDocument(uri);
+    void Server::onDidChangeContent(const Request&,
+                                    const DidChangeTextDocumentParams& params) {
+        // Handle the "didChangeContent" notification
+        std::string_view uri = params.textDocument.uri;
+        int version = params.textDocument.version;
 
-            std::cerr << "[Did Open] " << uri << " (length: " << text.length()
-                      << ")" << std::endl;
+        // All changes land in one new snapshot; ranged ones are relative to
+        // the result of the previous change in this notification
+        if (!params.contentChanges.empty()) {
+            updateDocument(uri, params.contentChanges, version);
         }
+
+        // Validate the document once the user pauses typing
+        scheduleValidation(uri, version, false);
+
+        LSP_LOG(Debug, "Did Change Content")
+            << uri << " (version: " << version << ")";
     }
 
-    void Server::onDidChangeContent(const json& request) {
-        // Handle the "didChangeContent" notification
-        if (request.contains("params")) {
-            std::string uri = request["params"]["textDocument"]["uri"];
-            int version = request["params"]["textDocument"]["version"];
-
-            // Handle incremental changes
-            if (request["params"].contains("contentChanges")) {
-                auto changes = request["params"]["contentChanges"];
-
-                for (const auto& change : changes) {
-                    if (change.contains("text") && !change.contains("range")) {
-                        // Full document update
-                        std::string newText = change["text"];
-                        updateDocument(uri, newText, version);
-                    } else if (change.contains("range") &&
-                               change.contains("text")) {
-                        // Incremental update - you'd need to implement
-                        // range-based updates
-                        std::cerr << "[Incremental Change] Not implemented yet"
-                                  << std::endl;
-                    }
+    void Server::onCompletion(const Request& request,
+                              const CompletionParams& params) {
+        // Handle the "completion" request. Items come pre-encoded; only
+        // their ranks and edit ranges are written per request.
+        request.checkCancelled();
+        CompletionResult result =
+            completions.complete(request.document.get(), params.position);
+        result.handle =
+            resolveTable.add(params.textDocument.uri, result.version, result);
+        sendResult(request.id, result);
+    }
+    void Server::onCompletionResolve(const Request& request,
+                                     const CompletionItem& item) {
+        // Handle the "completionResolve" request. Results only carry label
+        // and kind; the rest is looked up here through the data handle.
+        // The item's strings live in the request's arena, which outlasts
+        // the reply.
+        CompletionItem result = item;
+        result.sortText.reset();
+
+        std::optional<ResolveTable::Item> found;
+        const json* data = item.data ? &*item.data : nullptr;
+        if (data != nullptr && data->is_array() && data->size() == 2 &&
+            (*data)[0].is_number_unsigned() &&
+            (*data)[1].is_number_unsigned()) {
+            found = resolveTable.find((*data)[0].get<uint64_t>(),
+                                      (*data)[1].get<uint32_t>());
+        }
+        if (found) {
+            const CompletionCache& cache = *found->cache;
+            if (!cache.detail(found->item).empty()) {
+                result.detail = cache.detail(found->item);
+            }
+            if (!cache.documentation(found->item).empty()) {
+                result.documentation = MarkupContent{
+                    "plaintext", std::string(cache.documentation(found->item))};
+            } else if (uint32_t declaration = cache.declaration(found->item);
+                       declaration != CompletionCache::NO_DECLARATION) {
+                SnapshotPtr document = getDocument(found->uri);
+                std::optional<std::string> markdown;
+                if (document) {
+                    markdown = renderDeclaration(*document, found->version,
+                                                 declaration,
+                                                 cache.label(found->item));
+                }
+                if (markdown) {
+                    result.documentation =
+                        MarkupContent{"markdown", std::move(*markdown)};
                 }
             }
+        }
 
-            // Validate the document after changes
-            validateDocument(uri);
-
-            std::cerr << "[Did Change Content] " << uri
-                      << " (version: " << version << ")" << std::endl;
-        }
-    }
-    void Server::onCompletion(const json& request) {
-        // Handle the "completion" request
-        json response = {
-            {"jsonrpc", "2.0"},
-            {"id", request["id"]},
-            {"result",
-             {{"isIncomplete", false},
-              {"items",
-               {{{"label", "Hello"},
-                 {"kind", 1}, // Text
-                 {"sortText", "0001"},
-                 {"detail", "Hello from swirl C++ lsp server"},
-                 {"documentation", "Text completion from swirl LSP server"}},
-                {{"label", "from"},
-                 {"kind", 2}, // Method
-                 {"sortText", "0002"},
-                 {"detail", "from swirl C++ lsp server"},
-                 {"documentation", "Method completion from swirl LSP server"}},
-                {{"label", "swirl"},
-                 {"kind", 3}, // Function
-                 {"sortText", "0003"},
-                 {"detail", "swirl C++ lsp server"},
-                 {"documentation",
-                  "Function completion from swirl LSP server"}},
-                {{"label", "C++"},
-                 {"kind", 6}, // Class
-                 {"sortText", "0004"},
-                 {"detail", "C++ lsp server"},
-                 {"documentation", "Class completion from swirl LSP server"}},
-                {{"label", "lsp"},
-                 {"kind", 7}, // Interface
-                 {"sortText", "0005"},
-                 {"detail", "lsp server"},
-                 {"documentation",
-                  "Interface completion from swirl LSP server"}},
-                {{"label", "server"},
-                 {"kind", 9}, // Module
-                 {"sortText", "0006"},
-                 {"detail", "server"},
-                 {"documentation",
-                  "Module completion from swirl LSP server"}}}}}}};
-        sendResponse(response);
+        sendResult(request.id, result);
+    }
+    void Server::onDidSave(const Request&,
+                           const DidSaveTextDocumentParams& params) {
+        // Handle the "didSave" notification
+        LSP_LOG(Debug, "Did Save") << params.textDocument.uri;
+        // Here you would typically save the document state
     }
-    void Server::onCompletionResolve(const json& request) {
-        // Handle the "completionResolve" request
-        json result = request["params"];
-        if (result.contains("sortText")) {
-            result.erase("sortText");
-        }
 
-        json response = {
-            {"jsonrpc", "2.0"}, {"id", request["id"]}, {"result", result}};
-        sendResponse(response);
+    void Server::onDidClose(const Request&,
+                            const DidCloseTextDocumentParams& params) {
+        // Handle the "didClose" notification. Validation of the document
+        // stops, and its diagnostics are cleared in the client.
+        std::string uri(params.textDocument.uri);
+        diagnostics.cancel(uri);
+        std::lock_guard lock(publishMutex);
+        removeDocument(uri);
+        sendNotification("textDocument/publishDiagnostics",
+                         PublishDiagnosticsParams{uri, std::nullopt, {}});
+        LSP_LOG(Debug, "Did Close") << uri;
     }
-    void Server::onSetTrace(const json& request) {
+
+    void Server::onSetTrace(const Request&, const SetTraceParams& params) {
         // Handle the "setTrace" notification
-        std::string traceValue = request["params"]["value"];
-        std::cerr << "[Set Trace] " << traceValue << std::endl;
+        Logger::instance().setLevel(levelForTrace(params.value));
+        LSP_LOG(Info, "Set Trace") << params.value;
     }
 
-    void Server::storeDocument(const std::string& uri,
-                               const std::string& content, int version) {
-        documents[uri] = content;
-        document_versions[uri] = version;
-        std::cerr << "[Document Stored] " << uri << " (version: " << version
-                  << ")" << std::endl;
+    void Server::storeDocument(std::string_view uri, std::string_view content,
+                               int version) {
+        documents.open(uri, content, version);
+        LSP_LOG(Debug, "Document Stored")
+            << uri << " (version: " << version << ")";
     }
 
-    void Server::updateDocument(const std::string& uri,
-                                const std::string& newContent, int version) {
-        if (hasDocument(uri)) {
-            documents[uri] = newContent;
-            document_versions[uri] = version;
-            std::cerr << "[Document Updated] " << uri
-                      << " (version: " << version << ")" << std::endl;
+    void Server::updateDocument(std::string_view uri,
+                                std::span<const TextChange> changes,
+                                int version) {
+        if (documents.update(uri, changes, version)) {
+            LSP_LOG(Debug, "Document Updated")
+                << uri << " (version: " << version << ")";
         }
     }
 
-    void Server::removeDocument(const std::string& uri) {
-        documents.erase(uri);
-        document_versions.erase(uri);
-        std::cerr << "[Document Removed] " << uri << std::endl;
+    void Server::removeDocument(std::string_view uri) {
+        documents.close(uri);
+        completions.forget(uri);
+        published.forget(uri);
+        LSP_LOG(Debug, "Document Removed") << uri;
+    }
+
+    SnapshotPtr Server::getDocument(std::string_view uri) {
+        return documents.get(uri);
     }
 
-    std::string Server::getDocument(const std::string& uri) {
-        return documents.contains(uri) ? documents[uri] : "";
+    void Server::scheduleValidation(std::string_view uri, int version,
+                                    bool immediate) {
+        diagnostics.schedule(std::string(uri), version, immediate);
     }
 
-    bool Server::hasDocument(const std::string& uri) {
-        return documents.contains(uri);
+    void Server::launchValidation(const std::string& uri, int version,
+                                  DiagnosticsScheduler::CancelFlag cancelled) {
+        // Diagnostics are read-only work: they run in parallel with hover
+        // and completion, after the edit that triggered them, and never hold
+        // up the edits that follow
+        scheduler.submit({[this, uri, version, cancelled,
+                           launched = StatsClock::now()] {
+                              stats.validation.queueWait.record(
+                                  elapsedNanoseconds(launched));
+                              currentStats = &stats.validation;
+                              auto start = StatsClock::now();
+                              validateDocument(uri, version, *cancelled);
+                              stats.validation.handler.record(
+                                  elapsedNanoseconds(start));
+                              currentStats = nullptr;
+                              diagnostics.finished(uri, cancelled);
+                          },
+                          Priority::Low, false, true});
     }
 
-    void Server::validateDocument(const std::string& uri) {
-        std::string content = getDocument(uri);
-        if (content.empty()) {
+    void Server::validateDocument(const std::string& uri, int version,
+                                  const std::atomic<bool>& cancelled) {
+        // Works on one immutable version even if edits arrive meanwhile. A
+        // newer version means a newer validation is already scheduled.
+        SnapshotPtr document = getDocument(uri);
+        if (!document || document->version != version) {
             return;
         }
-
-        // Find the import statements and check if they don't provide any
-        // package
-        std::regex import_pattern(R"(\bimport(?! \w))");
-        std::sregex_iterator start(content.begin(), content.end(),
-                                   import_pattern);
-        std::sregex_iterator end;
-
-        json diagnostics = json::array();
-
-        for (std::sregex_iterator i = start; i != end; ++i) {
-            std::smatch match = *i;
-            size_t match_pos = match.position();
-            size_t match_length = match.length();
-
-            // Calculate line and character positions
-            auto start_pos = calculatePosition(content, match_pos);
-            auto end_pos = calculatePosition(content, match_pos + match_length);
-
-            json diagnostic = {
-                {"severity", 1}, // Error severity
-                {"range",
-                 {{"start",
-                   {{"line", start_pos.first},
-                    {"character", start_pos.second}}},
-                  {"end",
-                   {{"line", end_pos.first}, {"character", end_pos.second}}}}},
-                {"message", "No package name provided"},
-                {"source", "Swirl"}};
-
-            diagnostics.push_back(diagnostic);
+        std::optional<std::vector<Diagnostic>> diagnostics =
+            computeDiagnostics(*document, cancelled, &lintSettings);
+        // A newer edit arrived while we were busy; its results will follow
+        if (!diagnostics) {
+            return;
         }
 
-        // Send the computed diagnostics
-        json diagnosticsNotification = {
-            {"jsonrpc", "2.0"},
-            {"method", "textDocument/publishDiagnostics"},
-            {"params", {{"uri", uri}, {"diagnostics", diagnostics}}}};
+        // The document may have been closed or changed since; checked
+        // under the lock a close takes, so it can't happen until sent
+        std::lock_guard lock(publishMutex);
+        if (cancelled.load(std::memory_order_relaxed) ||
+            getDocument(uri) != document) {
+            return;
+        }
 
-        sendResponse(diagnosticsNotification);
+        // Most edits leave the diagnostics as they were; the client
+        // already shows those
+        size_t count = diagnostics->size();
+        if (!published.update(uri, version, diagnosticsHash(*diagnostics)) &&
+            !publishUnchanged.load(std::memory_order_relaxed)) {
+            LSP_LOG(Debug, "Diagnostics") << "Unchanged for " << uri;
+            return;
+        }
+        sendNotification("textDocument/publishDiagnostics",
+                         PublishDiagnosticsParams{uri, document->version,
+                                                  std::move(*diagnostics)});
 
-        std::cerr << "[Diagnostics] Found " << diagnostics.size()
-                  << " issues in " << uri << std::endl;
+        LSP_LOG(Debug, "Diagnostics")
+            << "Found " << count << " issues in " << uri;
     }
 
-    std::pair<int, int> Server::calculatePosition(const std::string& content,
-                                                  size_t offset) {
-        int line = 0;
-        int character = 0;
+    void Server::onDocumentDiagnostic(const Request& request,
+                                      const DocumentDiagnosticParams& params) {
+        // Handle the pull-model "diagnostic" request. Result ids are the
+        // hashes pushed diagnostics are compared by.
+        std::string_view uri = params.textDocument.uri;
+        SnapshotPtr document = getDocument(uri);
+        request.checkCancelled();
+        std::optional<std::string_view> previous = params.previousResultId;
+
+        // Diagnostics already published for this version need not be
+        // computed again to tell the client it has them
+        std::optional<PublishedDiagnostics::Entry> last = published.find(uri);
+        if (document && previous && last &&
+            last->version == document->version &&
+            *previous == diagnosticsResultId(last->hash)) {
+            sendResult(request.id, DocumentDiagnosticReport{
+                                       "unchanged", std::string(*previous),
+                                       std::nullopt});
+            return;
+        }
 
-        for (size_t i = 0; i < offset && i < content.length(); ++i) {
-            if (content[i] == '\n') {
-                line++;
-                character = 0;
-            } else {
-                character++;
+        std::vector<Diagnostic> diagnostics;
+        if (document) {
+            const std::atomic<bool> notCancelled{false};
+            std::optional<std::vector<Diagnostic>> computed =
+                computeDiagnostics(*document,
+                                   request.cancelled ? *request.cancelled
+                                                     : notCancelled,
+                                   &lintSettings);
+            if (!computed) {
+                throw RequestCancelled();
             }
+            diagnostics = std::move(*computed);
         }
-
-        return {line, character};
+        std::string resultId =
+            diagnosticsResultId(diagnosticsHash(diagnostics));
+        if (previous == resultId) {
+            sendResult(request.id,
+                       DocumentDiagnosticReport{"unchanged",
+                                                std::move(resultId),
+                                                std::nullopt});
+            return;
+        }
+        sendResult(request.id,
+                   DocumentDiagnosticReport{"full", std::move(resultId),
+                                            std::move(diagnostics)});
     }
 
-    void Server::onHover(const json& request) {
+    void Server::onHover(const Request& request, const HoverParams& params) {
         // Handle the "hover" request
-        std::string uri = request["params"]["textDocument"]["uri"];
-        int line = request["params"]["position"]["line"];
-        int character = request["params"]["position"]["character"];
-        std::string content = getDocument(uri);
-
-        std::string word = getWordAt(content, line, character);
-
-        std::string hoverText = "No info available";
-        if (!word.empty()) {
-            hoverText = "Hover info for `" + word + "`";
-        }
-
-        json response = {
-            {"jsonrpc", "2.0"},
-            {"id", request["id"]},
-            {"result",
-                {
-                    {"contents",
-                        {
-                            {"kind", "markdown"},
-                            {"value", hoverText}
-                        }
-                    }
-                }
-            }
-        };
-        sendResponse(response);
+        request.checkCancelled();
+
+        std::string text = hoverText(*request.document, params.position);
+
+        sendResult(request.id, Hover{{"markdown", std::move(text)}});
+
+        LSP_LOG(Debug, "Hover") << params.textDocument.uri;
     }
 } // namespace LSP
\ No newline at end of file
@@ -0,0 +1,259 @@
+#include "Lexer.h"
+#include <array>
+#include <cstring>
+
+namespace {
+
+    using lsp::TokenKind;
+
+    enum CharClass : uint8_t {
+        Space,
+        Newline,
+        IdentStart,
+        Digit,
+        Quote,
+        Slash,
+        OperatorChar,
+        Punctuation,
+        Other,
+    };
+
+    constexpr std::array<CharClass, 256> makeClassTable() {
+        std::array<CharClass, 256> table{};
+        for (auto& entry : table) {
+            entry = Other;
+        }
+        for (int c = 'a'; c <= 'z'; ++c) table[c] = IdentStart;
+        for (int c = 'A'; c <= 'Z'; ++c) table[c] = IdentStart;
+        for (int c = '0'; c <= '9'; ++c) table[c] = Digit;
+        // UTF-8 lead and continuation bytes are identifier characters
+        for (int c = 0x80; c < 0x100; ++c) table[c] = IdentStart;
+        table['_'] = IdentStart;
+        table[' '] = table['\t'] = table['\r'] = table['\f'] = Space;
+        table['\v'] = Space;
+        table['\n'] = Newline;
+        table['"'] = table['\''] = Quote;
+        table['/'] = Slash;
+        for (char c : std::string_view("+-*%=!<>&|^~?@#$")) {
+            table[static_cast<unsigned char>(c)] = OperatorChar;
+        }
+        for (char c : std::string_view("()[]{},.:;")) {
+            table[static_cast<unsigned char>(c)] = Punctuation;
+        }
+        return table;
+    }
+
+    constexpr auto CLASS = makeClassTable();
+
+    constexpr bool isIdentChar(unsigned char c) {
+        return CLASS[c] == IdentStart || CLASS[c] == Digit;
+    }
+
+    struct Keyword {
+        std::string_view text;
+        TokenKind kind;
+    };
+
+    // Sorted by length; the size check rejects almost every candidate
+    // before any characters are compared
+    constexpr Keyword KEYWORDS[] = {
+        {"as", TokenKind::KwAs},         {"fn", TokenKind::KwFn},
+        {"if", TokenKind::KwIf},         {"in", TokenKind::KwIn},
+        {"for", TokenKind::KwFor},       {"var", TokenKind::KwVar},
+        {"elif", TokenKind::KwElif},     {"else", TokenKind::KwElse},
+        {"true", TokenKind::KwTrue},     {"break", TokenKind::KwBreak},
+        {"const", TokenKind::KwConst},   {"false", TokenKind::KwFalse},
+        {"while", TokenKind::KwWhile},   {"export", TokenKind::KwExport},
+        {"import", TokenKind::KwImport}, {"return", TokenKind::KwReturn},
+        {"struct", TokenKind::KwStruct}, {"continue", TokenKind::KwContinue},
+    };
+
+    TokenKind classifyWord(std::string_view word) {
+        if (word.size() < 2 || word.size() > 8) {
+            return TokenKind::Identifier;
+        }
+        for (const Keyword& keyword : KEYWORDS) {
+            if (keyword.text.size() == word.size() && keyword.text == word) {
+                return keyword.kind;
+            }
+        }
+        return TokenKind::Identifier;
+    }
+
+    // Two-character operators, matched greedily
+    bool isCompoundOperator(char a, char b) {
+        switch (a) {
+        case '=':
+        case '!':
+        case '<':
+        case '>':
+            return b == '=' || (a == b && a != '!');
+        case '+':
+        case '*':
+        case '%':
+        case '^':
+            return b == '=';
+        case '-':
+            return b == '=' || b == '>';
+        case '&':
+        case '|':
+            return b == a || b == '=';
+        default:
+            return false;
+        }
+    }
+
+    TokenKind punctuationKind(char c) {
+        switch (c) {
+        case '(': return TokenKind::LParen;
+        case ')': return TokenKind::RParen;
+        case '{': return TokenKind::LBrace;
+        case '}': return TokenKind::RBrace;
+        case '[': return TokenKind::LBracket;
+        case ']': return TokenKind::RBracket;
+        case ',': return TokenKind::Comma;
+        case '.': return TokenKind::Dot;
+        case ':': return TokenKind::Colon;
+        default: return TokenKind::Semicolon;
+        }
+    }
+} // namespace
+
+namespace lsp {
+
+    bool isKeyword(TokenKind kind) {
+        return kind >= TokenKind::KwAs;
+    }
+
+    std::vector<Token> tokenize(std::string_view source) {
+        std::vector<Token> tokens;
+        tokenize(source, tokens);
+        return tokens;
+    }
+
+    void tokenize(std::string_view source, std::vector<Token>& out) {
+        // Rough guess that avoids most regrowth on real code
+        out.reserve(out.size() + source.size() / 3);
+
+        const char* const begin = source.data();
+        const char* const end = begin + source.size();
+        const char* p = begin;
+
+        auto emit = [&](TokenKind kind, const char* start) {
+            out.push_back({kind, static_cast<uint32_t>(start - begin),
+                           static_cast<uint32_t>(p - start)});
+        };
+        // End of the current line, or of the input
+        auto lineEnd = [&](const char* from) {
+            const void* nl = std::memchr(from, '\n', end - from);
+            return nl ? static_cast<const char*>(nl) : end;
+        };
+
+        while (p < end) {
+            const char* start = p;
+            unsigned char c = static_cast<unsigned char>(*p);
+
+            switch (CLASS[c]) {
+            case Space:
+                ++p;
+                while (p < end && CLASS[static_cast<unsigned char>(*p)] == Space) {
+                    ++p;
+                }
+                break;
+
+            case Newline:
+                ++p;
+                emit(TokenKind::Newline, start);
+                break;
+
+            case IdentStart:
+                ++p;
+                while (p < end && isIdentChar(static_cast<unsigned char>(*p))) {
+                    ++p;
+                }
+                emit(classifyWord(std::string_view(start, p - start)), start);
+                break;
+
+            case Digit:
+                // Covers decimal, hex and float literals; the exact grammar
+                // doesn't matter for tokenization
+                ++p;
+                while (p < end &&
+                       (isIdentChar(static_cast<unsigned char>(*p)) ||
+                        (*p == '.' && p + 1 < end &&
+                         CLASS[static_cast<unsigned char>(p[1])] == Digit))) {
+                    ++p;
+                }
+                emit(TokenKind::Number, start);
+                break;
+
+            case Quote: {
+                // Strings end at the matching quote or, unterminated, at the
+                // end of the line
+                char quote = *p++;
+                const char* stop = lineEnd(p);
+                while (p < stop) {
+                    const void* hit = std::memchr(p, quote, stop - p);
+                    if (hit == nullptr) {
+                        p = stop;
+                        break;
+                    }
+                    const char* q = static_cast<const char*>(hit);
+                    // The quote is escaped if preceded by an odd number of
+                    // backslashes
+                    size_t backslashes = 0;
+                    while (q - backslashes > p && q[-1 - backslashes] == '\\') {
+                        ++backslashes;
+                    }
+                    p = q + 1;
+                    if (backslashes % 2 == 0) {
+                        break;
+                    }
+                }
+                emit(TokenKind::String, start);
+                break;
+            }
+
+            case Slash:
+                if (p + 1 < end && p[1] == '/') {
+                    p = lineEnd(p);
+                    emit(TokenKind::Comment, start);
+                } else if (p + 1 < end && p[1] == '*') {
+                    p += 2;
+                    while (true) {
+                        const void* star = std::memchr(p, '*', end - p);
+                        if (star == nullptr) {
+                            p = end;
+                            break;
+                        }
+                        p = static_cast<const char*>(star) + 1;
+                        if (p < end && *p == '/') {
+                            ++p;
+                            break;
+                        }
+                    }
+                    emit(TokenKind::Comment, start);
+                } else {
+                    p += (p + 1 < end && p[1] == '=') ? 2 : 1;
+                    emit(TokenKind::Operator, start);
+                }
+                break;
+
+            case OperatorChar:
+                p += (p + 1 < end && isCompoundOperator(p[0], p[1])) ? 2 : 1;
+                emit(TokenKind::Operator, start);
+                break;
+
+            case Punctuation:
+                ++p;
+                emit(punctuationKind(*start), start);
+                break;
+
+            case Other:
+                ++p;
+                emit(TokenKind::Unknown, start);
+                break;
+            }
+        }
+    }
+} // namespace lsp
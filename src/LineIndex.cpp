@@ -0,0 +1,244 @@
+#include "LineIndex.h"
+#include <algorithm>
+#include <string>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+    // Lines per LineIndex block. An edit rebuilds about one block.
+    constexpr size_t BLOCK_LINES = 1024;
+
+    size_t sequenceLength(unsigned char lead) {
+        return lead < 0x80 ? 1 : lead < 0xE0 ? 2 : lead < 0xF0 ? 3 : 4;
+    }
+
+    // Byte offset within `line` of the given UTF-16 column, clamped to the
+    // end of the line
+    size_t utf16ToByte(std::string_view line, size_t units) {
+        size_t i = 0;
+        size_t count = 0;
+        while (i < line.size() && count < units && line[i] != '\n') {
+            size_t length = sequenceLength(static_cast<unsigned char>(line[i]));
+            // Characters outside the BMP are a surrogate pair in UTF-16
+            count += length == 4 ? 2 : 1;
+            i += length;
+        }
+        return std::min(i, line.size());
+    }
+
+    // Number of UTF-16 code units in `text`
+    size_t utf16Length(std::string_view text) {
+        size_t count = 0;
+        for (size_t i = 0; i < text.size();) {
+            size_t length = sequenceLength(static_cast<unsigned char>(text[i]));
+            count += length == 4 ? 2 : 1;
+            i += length;
+        }
+        return count;
+    }
+
+    // UTF-16 code units of the characters starting in `bytes`, which may
+    // begin or end inside a character: one per lead byte, two for those
+    // of four-byte sequences
+    size_t utf16Units(std::string_view bytes) {
+        size_t count = 0;
+        for (char c : bytes) {
+            auto byte = static_cast<unsigned char>(c);
+            count += (byte & 0xC0) != 0x80;
+            count += byte >= 0xF0;
+        }
+        return count;
+    }
+} // namespace
+
+namespace lsp {
+
+    LineIndex::LineIndex() {
+        appendBlocks({0});
+    }
+
+    LineIndex::LineIndex(std::string_view text) {
+        std::vector<size_t> starts{0};
+        scanNewlines(text, 0, starts);
+        appendBlocks(starts);
+    }
+
+    LineIndex::LineIndex(const Rope& text) {
+        std::vector<size_t> starts{0};
+        size_t base = 0;
+        text.forEachChunk([&](std::string_view chunk) {
+            scanNewlines(chunk, base, starts);
+            base += chunk.size();
+            return true;
+        });
+        appendBlocks(starts);
+    }
+
+    void LineIndex::appendBlocks(const std::vector<size_t>& starts) {
+        for (size_t i = 0; i < starts.size(); i += BLOCK_LINES) {
+            size_t lines = std::min(BLOCK_LINES, starts.size() - i);
+            auto block = std::make_shared<Block>(lines);
+            for (size_t j = 0; j < lines; ++j) {
+                (*block)[j] = static_cast<uint32_t>(starts[i + j] - starts[i]);
+            }
+            pieces.push_back({std::move(block), starts[i], count});
+            count += lines;
+        }
+    }
+
+    void LineIndex::scanNewlines(std::string_view text, size_t base,
+                                 std::vector<size_t>& out) {
+        const char* data = text.data();
+        size_t size = text.size();
+        size_t i = 0;
+#if defined(__SSE2__)
+        // Compare 16 bytes at a time and walk the set bits of the mask
+        const __m128i newline = _mm_set1_epi8('\n');
+        for (; i + 16 <= size; i += 16) {
+            __m128i block =
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            unsigned mask = static_cast<unsigned>(
+                _mm_movemask_epi8(_mm_cmpeq_epi8(block, newline)));
+            while (mask != 0) {
+                out.push_back(base + i + __builtin_ctz(mask) + 1);
+                mask &= mask - 1;
+            }
+        }
+#endif
+        for (; i < size; ++i) {
+            if (data[i] == '\n') {
+                out.push_back(base + i + 1);
+            }
+        }
+    }
+
+    size_t LineIndex::pieceOfLine(size_t line) const {
+        auto it = std::upper_bound(
+            pieces.begin(), pieces.end(), line,
+            [](size_t value, const Piece& p) { return value < p.firstLine; });
+        return static_cast<size_t>(it - pieces.begin()) - 1;
+    }
+
+    size_t LineIndex::pieceOfOffset(size_t offset) const {
+        auto it = std::upper_bound(
+            pieces.begin(), pieces.end(), offset,
+            [](size_t value, const Piece& p) { return value < p.offset; });
+        return static_cast<size_t>(it - pieces.begin()) - 1;
+    }
+
+    size_t LineIndex::lineStart(size_t line) const {
+        const Piece& piece = pieces[pieceOfLine(line)];
+        return piece.offset + (*piece.block)[line - piece.firstLine];
+    }
+
+    size_t LineIndex::lineOf(size_t offset) const {
+        const Piece& piece = pieces[pieceOfOffset(offset)];
+        const Block& block = *piece.block;
+        auto it = std::upper_bound(block.begin(), block.end(),
+                                   offset - piece.offset);
+        return piece.firstLine + static_cast<size_t>(it - block.begin()) - 1;
+    }
+
+    void LineIndex::applyEdit(size_t offset, size_t length,
+                              std::string_view text) {
+        // Line starts in (offset, offset + length] came from newlines
+        // inside the replaced range. The blocks holding the two ends are
+        // rebuilt from the lines they keep and the new text's newlines.
+        size_t end = offset + length;
+        size_t first = pieceOfOffset(offset);
+        size_t last = pieceOfOffset(end);
+        size_t delta = text.size() - length; // wraps for shrinking edits
+
+        std::vector<size_t> starts;
+        const Piece& head = pieces[first];
+        for (uint32_t start : *head.block) {
+            if (head.offset + start > offset) {
+                break;
+            }
+            starts.push_back(head.offset + start);
+        }
+        scanNewlines(text, offset, starts);
+        const Piece& tail = pieces[last];
+        for (uint32_t start : *tail.block) {
+            if (tail.offset + start > end) {
+                starts.push_back(tail.offset + start + delta);
+            }
+        }
+        // A short run takes in the next block, so blocks don't fragment
+        // over many small edits
+        size_t next = last + 1;
+        if (starts.size() < BLOCK_LINES / 2 && next < pieces.size()) {
+            for (uint32_t start : *pieces[next].block) {
+                starts.push_back(pieces[next].offset + start + delta);
+            }
+            ++next;
+        }
+
+        // Blocks after the edit are shared and only move
+        std::vector<Piece> moved(pieces.begin() + next, pieces.end());
+        count = pieces[first].firstLine;
+        pieces.resize(first);
+        appendBlocks(starts);
+        for (Piece& piece : moved) {
+            piece.offset += delta;
+            piece.firstLine = count;
+            count += piece.block->size();
+            pieces.push_back(std::move(piece));
+        }
+    }
+
+    size_t LineIndex::offsetAt(std::string_view text, int line,
+                               int character) const {
+        if (line < 0) {
+            return 0;
+        }
+        if (static_cast<size_t>(line) >= count) {
+            return text.size();
+        }
+        size_t start = std::min(lineStart(line), text.size());
+        return start + utf16ToByte(text.substr(start),
+                                   static_cast<size_t>(std::max(character, 0)));
+    }
+
+    size_t LineIndex::offsetAt(const Rope& text, int line,
+                               int character) const {
+        if (line < 0) {
+            return 0;
+        }
+        if (static_cast<size_t>(line) >= count) {
+            return text.size();
+        }
+        size_t start = lineStart(line);
+        size_t column = static_cast<size_t>(std::max(character, 0));
+        // A UTF-16 code unit is never more than three UTF-8 bytes
+        std::string prefix = text.substr(start, column * 3);
+        return start + utf16ToByte(prefix, column);
+    }
+
+    std::pair<int, int> LineIndex::positionAt(std::string_view text,
+                                              size_t offset) const {
+        offset = std::min(offset, text.size());
+        size_t line = lineOf(offset);
+        size_t start = lineStart(line);
+        return {static_cast<int>(line),
+                static_cast<int>(
+                    utf16Length(text.substr(start, offset - start)))};
+    }
+
+    std::pair<int, int> LineIndex::positionAt(const Rope& text,
+                                              size_t offset) const {
+        offset = std::min(offset, text.size());
+        size_t line = lineOf(offset);
+        size_t start = lineStart(line);
+        // Counted chunk by chunk, so the line is never copied out
+        size_t units = 0;
+        text.forEachChunk(start, offset - start, [&](std::string_view chunk) {
+            units += utf16Units(chunk);
+            return true;
+        });
+        return {static_cast<int>(line), static_cast<int>(units)};
+    }
+} // namespace lsp
@@ -0,0 +1,222 @@
+#include "LintEngine.h"
+#include <algorithm>
+#include <cassert>
+#include <map>
+#include <utility>
+
+namespace lsp {
+
+    TokenSet TokenSet::of(std::initializer_list<TokenKind> kinds,
+                          bool endOfTokens) {
+        TokenSet set;
+        for (TokenKind kind : kinds) {
+            set.bits |= uint64_t{1} << static_cast<size_t>(kind);
+        }
+        if (endOfTokens) {
+            set.bits |= uint64_t{1} << END_OF_TOKENS;
+        }
+        return set;
+    }
+
+    TokenSet TokenSet::except(std::initializer_list<TokenKind> kinds) {
+        TokenSet set;
+        set.bits = ((uint64_t{1} << LINT_SYMBOLS) - 1) & ~of(kinds).bits;
+        return set;
+    }
+
+    LintEngine::LintEngine(std::vector<LintRule> rules)
+        : rules(std::move(rules)) {
+        compile();
+    }
+
+    std::optional<size_t> LintEngine::find(std::string_view id) const {
+        for (size_t i = 0; i < rules.size(); ++i) {
+            if (rules[i].id == id) {
+                return i;
+            }
+        }
+        return std::nullopt;
+    }
+
+    // Subset construction. A pattern position (rule, i) means the first i
+    // steps of the rule matched; a DFA state is the set of positions
+    // reachable after the tokens read so far. Every state also holds the
+    // start of every rule, so matches may begin at any token.
+    void LintEngine::compile() {
+        using Position = std::pair<uint32_t, uint32_t>;
+        using Positions = std::vector<Position>;
+
+        for (const LintRule& rule : rules) {
+            // A match must end on a fixed step long enough to report from
+            size_t fixedTail = 0;
+            for (auto it = rule.pattern.rbegin();
+                 it != rule.pattern.rend() && !it->repeat; ++it) {
+                ++fixedTail;
+            }
+            assert(rule.reportTo <= rule.reportFrom &&
+                   rule.reportFrom < fixedTail && fixedTail <= HISTORY);
+            (void)fixedTail;
+        }
+
+        // Adds the positions a repeated step can be skipped to
+        auto close = [&](Positions& set) {
+            for (size_t i = 0; i < set.size(); ++i) {
+                auto [rule, step] = set[i];
+                const std::vector<PatternStep>& pattern = rules[rule].pattern;
+                if (step < pattern.size() && pattern[step].repeat) {
+                    set.emplace_back(rule, step + 1);
+                }
+            }
+            std::sort(set.begin(), set.end());
+            set.erase(std::unique(set.begin(), set.end()), set.end());
+        };
+
+        Positions start;
+        for (uint32_t rule = 0; rule < rules.size(); ++rule) {
+            start.emplace_back(rule, 0);
+        }
+        close(start);
+
+        std::map<Positions, uint32_t> ids;
+        std::vector<Positions> states;
+        auto intern = [&](Positions set) {
+            auto [it, added] =
+                ids.emplace(set, static_cast<uint32_t>(states.size()));
+            if (added) {
+                states.push_back(std::move(set));
+            }
+            return it->second;
+        };
+        intern(start);
+
+        for (uint32_t state = 0; state < states.size(); ++state) {
+            for (size_t symbol = 0; symbol < LINT_SYMBOLS; ++symbol) {
+                Positions next = start;
+                for (auto [rule, step] : states[state]) {
+                    const std::vector<PatternStep>& pattern =
+                        rules[rule].pattern;
+                    if (step == pattern.size() ||
+                        !pattern[step].set.contains(symbol)) {
+                        continue;
+                    }
+                    next.emplace_back(rule,
+                                      pattern[step].repeat ? step : step + 1);
+                }
+                close(next);
+                transitions.push_back(intern(std::move(next)));
+            }
+        }
+
+        // A complete match is only reported by the state it completes in;
+        // it is dropped on the next transition, as nothing follows it
+        for (const Positions& state : states) {
+            acceptStart.push_back(static_cast<uint32_t>(accepts.size()));
+            for (auto [rule, step] : state) {
+                if (step == rules[rule].pattern.size()) {
+                    accepts.push_back(rule);
+                }
+            }
+        }
+        acceptStart.push_back(static_cast<uint32_t>(accepts.size()));
+    }
+
+    LintSettings::LintSettings(const LintEngine& engine)
+        : engine(engine),
+          levels(std::make_unique<std::atomic<uint8_t>[]>(engine.size())) {
+        for (size_t i = 0; i < engine.size(); ++i) {
+            levels[i].store(static_cast<uint8_t>(engine.rule(i).severity),
+                            std::memory_order_relaxed);
+        }
+    }
+
+    bool LintSettings::set(std::string_view id,
+                           std::optional<DiagnosticSeverity> severity) {
+        bool found = false;
+        for (size_t i = 0; i < engine.size(); ++i) {
+            if (engine.rule(i).id == id) {
+                levels[i].store(severity ? static_cast<uint8_t>(*severity)
+                                         : 0,
+                                std::memory_order_relaxed);
+                found = true;
+            }
+        }
+        return found;
+    }
+
+    std::optional<DiagnosticSeverity> LintSettings::severity(size_t rule) const {
+        uint8_t level = levels[rule].load(std::memory_order_relaxed);
+        if (level == 0) {
+            return std::nullopt;
+        }
+        return static_cast<DiagnosticSeverity>(level);
+    }
+
+    const LintEngine& lintEngine() {
+        using enum TokenKind;
+        auto one = [](std::initializer_list<TokenKind> kinds,
+                      bool endOfTokens = false) {
+            return PatternStep{TokenSet::of(kinds, endOfTokens)};
+        };
+        auto anyBut = [](std::initializer_list<TokenKind> kinds) {
+            return PatternStep{TokenSet::except(kinds)};
+        };
+        auto many = [](PatternStep step) {
+            step.repeat = true;
+            return step;
+        };
+
+        static const LintEngine engine({
+            {"missing-package",
+             "No package name provided",
+             DiagnosticSeverity::Error,
+             {one({KwImport}), anyBut({Identifier})},
+             1,
+             1},
+            {"constant-condition",
+             "Condition is constant",
+             DiagnosticSeverity::Warning,
+             {one({KwIf, KwElif, KwWhile}), one({KwTrue, KwFalse}),
+              one({LBrace})},
+             1,
+             1},
+            // Only the closing brace is underlined when the block spans
+            // lines, as reports reach back over fixed steps only
+            {"empty-block",
+             "Empty block",
+             DiagnosticSeverity::Hint,
+             {one({LBrace}), many(one({Newline})), one({RBrace})},
+             0,
+             0},
+            {"unnecessary-semicolon",
+             "Unnecessary semicolon",
+             DiagnosticSeverity::Hint,
+             {one({Semicolon}), one({Newline, Semicolon, RBrace}, true)},
+             1,
+             1},
+            // A statement after return, break or continue in the same
+            // block. A value ending in an operator, a comma or an open
+            // bracket goes on past the newline, so it must end in
+            // another token; the second pattern is the case without one.
+            {"unreachable-code",
+             "Unreachable code",
+             DiagnosticSeverity::Warning,
+             {one({KwReturn, KwBreak, KwContinue}),
+              many(anyBut({Newline, Semicolon, LBrace, RBrace})),
+              anyBut({Newline, Semicolon, LBrace, RBrace, Operator, Comma,
+                      Dot, LParen, LBracket}),
+              one({Newline, Semicolon}), many(one({Newline, Semicolon})),
+              anyBut({Newline, Semicolon, RBrace})},
+             0,
+             0},
+            {"unreachable-code",
+             "Unreachable code",
+             DiagnosticSeverity::Warning,
+             {one({KwReturn, KwBreak, KwContinue}), one({Newline, Semicolon}),
+              many(one({Newline, Semicolon})),
+              anyBut({Newline, Semicolon, RBrace})},
+             0,
+             0},
+        });
+        return engine;
+    }
+} // namespace lsp
@@ -0,0 +1,281 @@
+#include "Logger.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    // How long the drain thread lets a burst of lines accumulate before
+    // writing it out
+    constexpr auto BATCH_INTERVAL = std::chrono::milliseconds(2);
+
+    // Longer lines are cut so a single record always fits a ring
+    constexpr size_t MAX_LINE = 8 * 1024;
+
+    const Clock::time_point START = Clock::now();
+
+    void writeAll(int fd, std::string_view data) {
+        while (!data.empty()) {
+            ssize_t n = ::write(fd, data.data(), data.size());
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return;
+            }
+            data.remove_prefix(static_cast<size_t>(n));
+        }
+    }
+} // namespace
+
+namespace lsp {
+
+    // Single-producer single-consumer byte ring. Records are a timestamp,
+    // a length and the line itself; positions only ever grow and are
+    // masked on access.
+    struct Logger::Ring {
+        static constexpr size_t CAPACITY = 64 * 1024;
+        static constexpr size_t RECORD_HEADER =
+            sizeof(uint64_t) + sizeof(uint32_t);
+
+        std::unique_ptr<char[]> data{new char[CAPACITY]};
+        alignas(64) std::atomic<size_t> head{0}; // written by the owner
+        alignas(64) std::atomic<size_t> tail{0}; // written by the drainer
+        std::atomic<uint64_t> dropped{0};
+        // Owning thread has exited; the ring goes once it's empty
+        std::atomic<bool> orphaned{false};
+
+        void copyIn(size_t position, const void* source, size_t length) {
+            size_t index = position & (CAPACITY - 1);
+            size_t first = std::min(length, CAPACITY - index);
+            std::memcpy(data.get() + index, source, first);
+            std::memcpy(data.get(), static_cast<const char*>(source) + first,
+                        length - first);
+        }
+
+        void copyOut(size_t position, void* target, size_t length) const {
+            size_t index = position & (CAPACITY - 1);
+            size_t first = std::min(length, CAPACITY - index);
+            std::memcpy(target, data.get() + index, first);
+            std::memcpy(static_cast<char*>(target) + first, data.get(),
+                        length - first);
+        }
+
+        bool push(uint64_t timestamp, std::string_view line) {
+            size_t h = head.load(std::memory_order_relaxed);
+            size_t t = tail.load(std::memory_order_acquire);
+            size_t needed = RECORD_HEADER + line.size();
+            if (CAPACITY - (h - t) < needed) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            uint32_t length = static_cast<uint32_t>(line.size());
+            copyIn(h, &timestamp, sizeof timestamp);
+            copyIn(h + sizeof timestamp, &length, sizeof length);
+            copyIn(h + RECORD_HEADER, line.data(), line.size());
+            head.store(h + needed, std::memory_order_release);
+            return true;
+        }
+    };
+
+    namespace {
+
+        // Marks the calling thread's ring as orphaned when the thread exits
+        struct LocalRing {
+            std::shared_ptr<Logger::Ring> ring;
+
+            ~LocalRing() {
+                if (ring) {
+                    ring->orphaned.store(true, std::memory_order_release);
+                }
+            }
+        };
+
+        thread_local LocalRing localRing;
+
+        struct Record {
+            uint64_t timestamp;
+            std::string line;
+        };
+    } // namespace
+
+    Logger& Logger::instance() {
+        static Logger logger;
+        return logger;
+    }
+
+    Logger::Logger() : thread([this] { loop(); }) {}
+
+    Logger::~Logger() {
+        stopping.store(true, std::memory_order_release);
+        wake();
+        thread.join();
+    }
+
+    Logger::Ring& Logger::localRing() {
+        auto& local = lsp::localRing;
+        if (!local.ring) {
+            local.ring = std::make_shared<Ring>();
+            std::lock_guard lock(ringsMutex);
+            rings.push_back(local.ring);
+        }
+        return *local.ring;
+    }
+
+    void Logger::write(LogLevel, std::string_view line) {
+        if (line.size() > MAX_LINE) {
+            line = line.substr(0, MAX_LINE);
+        }
+        auto timestamp = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                                 START)
+                .count());
+        if (localRing().push(timestamp, line)) {
+            wake();
+        }
+    }
+
+    void Logger::wake() {
+        // Only the first write after a drain pays for the exchange and the
+        // wakeup
+        if (pending.load(std::memory_order_relaxed) == 0 &&
+            pending.exchange(1) == 0) {
+            pending.notify_one();
+        }
+    }
+
+    void Logger::flush() {
+        uint32_t ticket = flushRequested.fetch_add(1) + 1;
+        if (pending.exchange(1) == 0) {
+            pending.notify_one();
+        }
+        uint32_t done = flushCompleted.load(std::memory_order_acquire);
+        while (static_cast<int32_t>(done - ticket) < 0) {
+            flushCompleted.wait(done, std::memory_order_acquire);
+            done = flushCompleted.load(std::memory_order_acquire);
+        }
+    }
+
+    void Logger::loop() {
+        std::string out;
+        while (true) {
+            pending.wait(0);
+
+            if (!stopping.load(std::memory_order_acquire) &&
+                flushRequested.load(std::memory_order_relaxed) ==
+                    flushCompleted.load(std::memory_order_relaxed)) {
+                std::this_thread::sleep_for(BATCH_INTERVAL);
+            }
+            // Cleared before looking at flush requests and draining: a
+            // write or flush from here on signals again and is picked up
+            // by the next round
+            pending.store(0);
+            bool stop = stopping.load();
+            uint32_t wanted = flushRequested.load();
+
+            out.clear();
+            drain(out);
+            writeAll(STDERR_FILENO, out);
+
+            if (wanted != flushCompleted.load(std::memory_order_relaxed)) {
+                flushCompleted.store(wanted, std::memory_order_release);
+                flushCompleted.notify_all();
+            }
+            if (stop) {
+                return;
+            }
+        }
+    }
+
+    void Logger::drain(std::string& out) {
+        std::vector<std::shared_ptr<Ring>> snapshot;
+        {
+            std::lock_guard lock(ringsMutex);
+            snapshot = rings;
+        }
+
+        std::vector<Record> records;
+        uint64_t dropped = 0;
+        for (const auto& ring : snapshot) {
+            // Read orphaned first so a ring isn't retired between its
+            // owner's last write and our read of head
+            bool orphaned = ring->orphaned.load(std::memory_order_acquire);
+            size_t t = ring->tail.load(std::memory_order_relaxed);
+            size_t h = ring->head.load(std::memory_order_acquire);
+            while (t < h) {
+                Record record;
+                uint32_t length;
+                ring->copyOut(t, &record.timestamp, sizeof record.timestamp);
+                ring->copyOut(t + sizeof record.timestamp, &length,
+                              sizeof length);
+                record.line.resize(length);
+                ring->copyOut(t + Ring::RECORD_HEADER, record.line.data(),
+                              length);
+                t += Ring::RECORD_HEADER + length;
+                records.push_back(std::move(record));
+            }
+            ring->tail.store(t, std::memory_order_release);
+            dropped += ring->dropped.exchange(0, std::memory_order_relaxed);
+
+            if (orphaned) {
+                std::lock_guard lock(ringsMutex);
+                std::erase(rings, ring);
+            }
+        }
+
+        // Each ring is in order already; interleave the threads by time
+        std::stable_sort(records.begin(), records.end(),
+                         [](const Record& a, const Record& b) {
+                             return a.timestamp < b.timestamp;
+                         });
+
+        for (const Record& record : records) {
+            char stamp[32];
+            int n = std::snprintf(stamp, sizeof stamp, "[%5llu.%06llu] ",
+                                  static_cast<unsigned long long>(
+                                      record.timestamp / 1000000000),
+                                  static_cast<unsigned long long>(
+                                      record.timestamp / 1000 % 1000000));
+            out.append(stamp, static_cast<size_t>(n));
+            out.append(record.line);
+            out.push_back('\n');
+        }
+        if (dropped > 0) {
+            out.append("WARN  [Log] ring buffer full, dropped ");
+            out.append(std::to_string(dropped));
+            out.append(" lines\n");
+        }
+    }
+
+    std::string_view toString(LogLevel level) {
+        switch (level) {
+        case LogLevel::Error: return "ERROR";
+        case LogLevel::Warn: return "WARN ";
+        case LogLevel::Info: return "INFO ";
+        default: return "DEBUG";
+        }
+    }
+
+    namespace {
+        thread_local std::string lineBuffer;
+    } // namespace
+
+    LogLine::LogLine(LogLevel level, std::string_view tag)
+        : level(level), buffer(lineBuffer), start(lineBuffer.size()) {
+        buffer.append(toString(level));
+        buffer.append(" [");
+        buffer.append(tag);
+        buffer.append("] ");
+    }
+
+    LogLine::~LogLine() {
+        Logger::instance().write(
+            level, std::string_view(buffer).substr(start));
+        buffer.resize(start);
+    }
+} // namespace lsp
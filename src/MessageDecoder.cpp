@@ -0,0 +1,27 @@
+#include "MessageDecoder.h"
+#include "JsonReader.h"
+
+namespace lsp {
+
+    bool scanEnvelope(std::string_view body, Envelope& envelope) {
+        JsonReader in(body);
+        if (!in.beginObject()) {
+            return false;
+        }
+        std::string_view key;
+        while (in.nextMember(key)) {
+            if (key == "method") {
+                if (!in.readString(envelope.method, envelope.methodStorage)) {
+                    return false;
+                }
+            } else if (key == "id") {
+                in.readRaw(envelope.id);
+            } else if (key == "params") {
+                in.readRaw(envelope.params);
+            } else {
+                in.skipValue();
+            }
+        }
+        return in.ok();
+    }
+} // namespace lsp
@@ -0,0 +1,150 @@
+#include "MessageReader.h"
+#include "Logger.h"
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <unistd.h>
+
+namespace {
+
+    constexpr std::string_view HEADER_TERMINATOR = "\r\n\r\n";
+
+    bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+        if (a.size() != b.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < a.size(); ++i) {
+            char x = a[i], y = b[i];
+            if (x >= 'A' && x <= 'Z') x += 'a' - 'A';
+            if (y >= 'A' && y <= 'Z') y += 'a' - 'A';
+            if (x != y) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::string_view trim(std::string_view s) {
+        while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) {
+            s.remove_prefix(1);
+        }
+        while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) {
+            s.remove_suffix(1);
+        }
+        return s;
+    }
+} // namespace
+
+namespace lsp {
+
+    MessageReader::MessageReader(int fd, size_t initialCapacity)
+        : fd(fd), buffer(initialCapacity) {}
+
+    std::optional<std::string_view> MessageReader::next() {
+        while (true) {
+            // Look for the end of the header block in what we already have
+            std::string_view pending(buffer.data() + begin, end - begin);
+            size_t headerEnd = pending.find(HEADER_TERMINATOR);
+            if (headerEnd == std::string_view::npos) {
+                if (!fill()) {
+                    return std::nullopt;
+                }
+                continue;
+            }
+
+            size_t contentLength = 0;
+            bool valid =
+                parseHeaders(pending.substr(0, headerEnd), contentLength);
+            begin += headerEnd + HEADER_TERMINATOR.size();
+            if (!valid) {
+                LSP_LOG(Warn, "Framing")
+                    << "Missing or invalid Content-Length, skipping header "
+                       "block";
+                continue;
+            }
+
+            // Make sure the whole body is buffered
+            while (end - begin < contentLength) {
+                if (buffer.size() - begin < contentLength) {
+                    // Body does not fit behind the current position; move
+                    // it to the front and grow if it still doesn't fit.
+                    std::memmove(buffer.data(), buffer.data() + begin,
+                                 end - begin);
+                    end -= begin;
+                    begin = 0;
+                    if (buffer.size() < contentLength) {
+                        buffer.resize(contentLength);
+                    }
+                }
+                if (!fill()) {
+                    return std::nullopt;
+                }
+            }
+
+            std::string_view body(buffer.data() + begin, contentLength);
+            begin += contentLength;
+            return body;
+        }
+    }
+
+    bool MessageReader::fill() {
+        if (begin == end) {
+            // Everything consumed, start over at the front for free
+            begin = end = 0;
+        } else if (end == buffer.size()) {
+            if (begin > 0) {
+                std::memmove(buffer.data(), buffer.data() + begin,
+                             end - begin);
+                end -= begin;
+                begin = 0;
+            } else {
+                buffer.resize(buffer.size() * 2);
+            }
+        }
+
+        while (true) {
+            ssize_t n = ::read(fd, buffer.data() + end, buffer.size() - end);
+            if (n > 0) {
+                end += static_cast<size_t>(n);
+                totalRead += static_cast<uint64_t>(n);
+                return true;
+            }
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n < 0) {
+                LSP_LOG(Error, "Framing")
+                    << "read failed: " << std::strerror(errno);
+            }
+            return false;
+        }
+    }
+
+    bool MessageReader::parseHeaders(std::string_view headers,
+                                     size_t& contentLength) {
+        bool found = false;
+        while (!headers.empty()) {
+            size_t lineEnd = headers.find("\r\n");
+            std::string_view line = headers.substr(0, lineEnd);
+            headers = lineEnd == std::string_view::npos
+                          ? std::string_view{}
+                          : headers.substr(lineEnd + 2);
+
+            size_t colon = line.find(':');
+            if (colon == std::string_view::npos) {
+                continue;
+            }
+            std::string_view name = trim(line.substr(0, colon));
+            std::string_view value = trim(line.substr(colon + 1));
+
+            if (equalsIgnoreCase(name, "Content-Length")) {
+                auto [ptr, ec] = std::from_chars(
+                    value.data(), value.data() + value.size(), contentLength);
+                found = ec == std::errc() && ptr == value.data() + value.size();
+            }
+            // Content-Type and unknown headers are accepted and ignored; the
+            // body is always treated as UTF-8 JSON.
+        }
+        return found;
+    }
+} // namespace lsp
@@ -0,0 +1,183 @@
+#include "MessageWriter.h"
+#include "Logger.h"
+#include <cerrno>
+#include <cstring>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace {
+
+    // Up to two iovecs per frame; stay well under IOV_MAX
+    constexpr size_t MAX_BATCH_FRAMES = 256;
+    constexpr size_t MAX_BATCH_BYTES = 1 << 20;
+} // namespace
+
+namespace lsp {
+
+    MessageWriter::MessageWriter(int fd,
+                                 std::chrono::microseconds flushLatency)
+        : fd(fd), flushLatency(flushLatency), head(&stub), tail(&stub) {
+        thread = std::thread([this] { loop(); });
+    }
+
+    MessageWriter::~MessageWriter() {
+        close();
+    }
+
+    void MessageWriter::send(std::string body) {
+        Frame* frame = new Frame;
+        frame->header =
+            "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n";
+        frame->body = std::move(body);
+        push(frame);
+
+        signal.fetch_add(1, std::memory_order_release);
+        signal.notify_one();
+    }
+
+    void MessageWriter::sendFrame(std::string buffer, size_t offset) {
+        Frame* frame = new Frame;
+        frame->body = std::move(buffer);
+        frame->offset = offset;
+        push(frame);
+
+        signal.fetch_add(1, std::memory_order_release);
+        signal.notify_one();
+    }
+
+    void MessageWriter::close() {
+        if (!thread.joinable()) {
+            return;
+        }
+        stopping.store(true, std::memory_order_release);
+        signal.fetch_add(1, std::memory_order_release);
+        signal.notify_one();
+        thread.join();
+    }
+
+    void MessageWriter::push(Frame* frame) {
+        frame->next.store(nullptr, std::memory_order_relaxed);
+        Frame* prev = head.exchange(frame, std::memory_order_acq_rel);
+        prev->next.store(frame, std::memory_order_release);
+    }
+
+    MessageWriter::Frame* MessageWriter::pop() {
+        Frame* first = tail;
+        Frame* next = first->next.load(std::memory_order_acquire);
+        if (first == &stub) {
+            if (next == nullptr) {
+                return nullptr;
+            }
+            tail = next;
+            first = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if (next != nullptr) {
+            tail = next;
+            return first;
+        }
+        if (first != head.load(std::memory_order_acquire)) {
+            // A producer is halfway through push(); pick it up next round
+            return nullptr;
+        }
+        push(&stub);
+        next = first->next.load(std::memory_order_acquire);
+        if (next != nullptr) {
+            tail = next;
+            return first;
+        }
+        return nullptr;
+    }
+
+    void MessageWriter::loop() {
+        std::vector<Frame*> batch;
+        batch.reserve(MAX_BATCH_FRAMES);
+
+        while (true) {
+            uint32_t seen = signal.load(std::memory_order_acquire);
+
+            size_t bytes = 0;
+            auto deadline = std::chrono::steady_clock::time_point::max();
+            while (batch.size() < MAX_BATCH_FRAMES && bytes < MAX_BATCH_BYTES) {
+                Frame* frame = pop();
+                if (frame != nullptr) {
+                    if (batch.empty()) {
+                        deadline =
+                            std::chrono::steady_clock::now() + flushLatency;
+                    }
+                    bytes += frame->header.size() + frame->body.size() -
+                             frame->offset;
+                    batch.push_back(frame);
+                    continue;
+                }
+                // Queue is dry. Keep the burst open for a little while so
+                // back-to-back notifications share one syscall.
+                if (batch.empty() || stopping.load(std::memory_order_acquire) ||
+                    std::chrono::steady_clock::now() >= deadline) {
+                    break;
+                }
+                std::this_thread::yield();
+            }
+
+            if (!batch.empty()) {
+                writeBatch(batch);
+                continue;
+            }
+            if (stopping.load(std::memory_order_acquire)) {
+                // send() may have raced with close(); drain once more
+                if (tail == &stub &&
+                    head.load(std::memory_order_acquire) == &stub) {
+                    break;
+                }
+                continue;
+            }
+            signal.wait(seen, std::memory_order_acquire);
+        }
+    }
+
+    void MessageWriter::writeBatch(std::vector<Frame*>& batch) {
+        std::vector<iovec> iov;
+        iov.reserve(batch.size() * 2);
+        for (Frame* frame : batch) {
+            if (!frame->header.empty()) {
+                iov.push_back({frame->header.data(), frame->header.size()});
+            }
+            iov.push_back({frame->body.data() + frame->offset,
+                           frame->body.size() - frame->offset});
+        }
+
+        size_t index = 0;
+        while (!broken && index < iov.size()) {
+            ssize_t n = ::writev(fd, iov.data() + index,
+                                 static_cast<int>(iov.size() - index));
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                LSP_LOG(Error, "Writer")
+                    << "writev failed: " << std::strerror(errno);
+                broken = true;
+                break;
+            }
+            this->written.fetch_add(static_cast<uint64_t>(n),
+                                    std::memory_order_relaxed);
+
+            // Skip fully written iovecs and trim a partially written one
+            size_t written = static_cast<size_t>(n);
+            while (index < iov.size() && written >= iov[index].iov_len) {
+                written -= iov[index].iov_len;
+                ++index;
+            }
+            if (written > 0) {
+                iov[index].iov_base =
+                    static_cast<char*>(iov[index].iov_base) + written;
+                iov[index].iov_len -= written;
+            }
+        }
+
+        for (Frame* frame : batch) {
+            delete frame;
+        }
+        batch.clear();
+    }
+} // namespace lsp
@@ -0,0 +1,905 @@
+#include "Parser.h"
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace lsp {
+
+    namespace {
+
+        constexpr uint32_t NONE = SyntaxChunk::NONE;
+        // Parent of the children of a postfix wrapper not yet placed,
+        // counting down from here by the wrapper's position in its chain
+        constexpr uint32_t WRAPPER = NONE - 1;
+
+        // A chunk is closed after the item that brings it to this many
+        // nodes. Reparsing after an edit covers about one chunk, and the
+        // chunk table a new version copies shrinks as chunks grow.
+        constexpr size_t CHUNK_NODES = 256;
+
+        // Nesting deeper than this is reported instead of recursed into
+        constexpr int MAX_DEPTH = 256;
+
+        // The parser's view of a TokenList from some offset on: comments
+        // are skipped, and a few tokens of lookahead are kept
+        class TokenStream {
+          public:
+            TokenStream(const TokenList& tokens, const Rope& text, size_t from)
+                : cursor(tokens, from), source(text) {}
+
+            // Whether there is a token `ahead` tokens past the current one
+            bool has(size_t ahead) {
+                while (pos + ahead >= pending.size()) {
+                    if (!pull()) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+            Token at(size_t ahead) const {
+                return pending[pos + ahead];
+            }
+            void advance() {
+                if (++pos == pending.size()) {
+                    pending.clear();
+                    pos = 0;
+                }
+            }
+
+            // Whether `token` reads `text`
+            bool spells(const Token& token, std::string_view text) {
+                if (token.length != text.size()) {
+                    return false;
+                }
+                // Tokens are looked at in order, so the text is read from
+                // the rope a window at a time
+                if (token.offset < windowStart ||
+                    token.end() > windowStart + window.size()) {
+                    windowStart = token.offset;
+                    window = source.substr(
+                        windowStart, std::max<size_t>(WINDOW, token.length));
+                }
+                return std::string_view(window).substr(
+                           token.offset - windowStart, token.length) == text;
+            }
+
+          private:
+            static constexpr size_t WINDOW = 4096;
+
+            TokenList::Cursor cursor;
+            const Rope& source;
+            std::vector<Token> pending;
+            size_t pos = 0;
+            std::string window;
+            size_t windowStart = 0;
+
+            bool pull() {
+                for (; !cursor.atEnd(); cursor.advance()) {
+                    Token token = cursor.token();
+                    if (!isTrivia(token.kind)) {
+                        cursor.advance();
+                        pending.push_back(token);
+                        return true;
+                    }
+                }
+                return false;
+            }
+        };
+
+        class Parser {
+          public:
+            Parser(const Rope& text, const TokenList& tokens, size_t from,
+                   NodeColumns& nodes, std::vector<SyntaxError>& errors)
+                : stream(tokens, text, from), nodes(nodes), errors(errors),
+                  size(static_cast<uint32_t>(text.size())),
+                  lastEnd(static_cast<uint32_t>(from)) {
+                refresh();
+            }
+
+            // Skips the newlines and semicolons between items
+            void skipSeparators() {
+                while (at(TokenKind::Newline) || at(TokenKind::Semicolon)) {
+                    advance();
+                }
+            }
+            bool atEnd() const {
+                return end;
+            }
+            // Start of the next token
+            size_t position() const {
+                return end ? size : next.offset;
+            }
+
+            void parseItem();
+
+          private:
+            TokenStream stream;
+            NodeColumns& nodes;
+            std::vector<SyntaxError>& errors;
+            std::vector<uint32_t> open; // nodes not closed yet
+            uint32_t size;
+            Token next{};
+            bool end = false;
+            // End of the last consumed token other than a newline, where
+            // nodes end and missing tokens are reported
+            uint32_t lastEnd;
+            uint32_t itemStart = 0;
+            int depth = 0;
+
+            void refresh() {
+                end = !stream.has(0);
+                if (!end) {
+                    next = stream.at(0);
+                }
+            }
+            void advance() {
+                if (next.kind != TokenKind::Newline) {
+                    lastEnd = next.end();
+                }
+                stream.advance();
+                refresh();
+            }
+            bool at(TokenKind kind) const {
+                return !end && next.kind == kind;
+            }
+            bool atOperator(std::string_view op) {
+                return at(TokenKind::Operator) && stream.spells(next, op);
+            }
+            // Kind of the token `ahead` past the current one, if any
+            bool peekIs(size_t ahead, TokenKind kind) {
+                return stream.has(ahead) && stream.at(ahead).kind == kind;
+            }
+            bool eat(TokenKind kind) {
+                if (!at(kind)) {
+                    return false;
+                }
+                advance();
+                return true;
+            }
+            void skipNewlines() {
+                while (at(TokenKind::Newline)) {
+                    advance();
+                }
+            }
+            bool atStatementEnd() const {
+                return end || at(TokenKind::Newline) ||
+                       at(TokenKind::Semicolon) || at(TokenKind::RBrace);
+            }
+
+            uint32_t start(NodeKind kind);
+            void finish(uint32_t node);
+            uint32_t precede(uint32_t first, NodeKind kind);
+            // A postfix operator's node, placed once its chain ends
+            struct Wrapper {
+                NodeKind kind;
+                uint32_t end;
+                uint32_t subtreeEnd; // before the wrappers are placed
+            };
+            void placeWrappers(uint32_t first,
+                               const std::vector<Wrapper>& wrappers);
+            // A node of the current token alone
+            void leaf(NodeKind kind) {
+                uint32_t node = start(kind);
+                advance();
+                finish(node);
+            }
+
+            // Something expected after the last consumed token is missing
+            void expected(const char* message) {
+                errors.push_back({std::max(lastEnd, itemStart), 0, message});
+            }
+            void expect(TokenKind kind, const char* message) {
+                if (!eat(kind)) {
+                    expected(message);
+                }
+            }
+            void recover(const char* message);
+            void endStatement() {
+                if (!atStatementEnd()) {
+                    recover("expected end of statement");
+                }
+            }
+
+            void parseStatement();
+            void parseImport();
+            void parseExport();
+            void parseFunction();
+            void parseParams();
+            void parseStruct();
+            void parseVariable(NodeKind kind);
+            void parseIf();
+            void parseLoop(NodeKind kind);
+            void parseBody();
+            void parseBlock();
+            void parseName(const char* message) {
+                if (at(TokenKind::Identifier)) {
+                    leaf(NodeKind::Name);
+                } else {
+                    expected(message);
+                }
+            }
+            void parseType();
+
+            bool startsExpression() const;
+            void parseExpression();
+            void parseUnary();
+            void parsePostfix();
+            bool parsePrimary();
+            void parseSequence(NodeKind kind, TokenKind close,
+                               const char* message);
+        };
+
+        uint32_t Parser::start(NodeKind kind) {
+            auto node = static_cast<uint32_t>(nodes.size());
+            uint32_t offset = end ? size : next.offset;
+            nodes.kinds.push_back(kind);
+            nodes.starts.push_back(offset);
+            nodes.ends.push_back(offset);
+            nodes.parents.push_back(open.empty() ? NONE : open.back());
+            nodes.subtreeEnds.push_back(node + 1);
+            open.push_back(node);
+            return node;
+        }
+
+        void Parser::finish(uint32_t node) {
+            open.pop_back();
+            nodes.ends[node] = std::max(lastEnd, nodes.starts[node]);
+            nodes.subtreeEnds[node] = static_cast<uint32_t>(nodes.size());
+        }
+
+        // Opens a node of `kind` around the finished nodes from `first` on,
+        // for constructs only recognized after their first operand
+        uint32_t Parser::precede(uint32_t first, NodeKind kind) {
+            auto slot = [first](auto& column) {
+                return column.begin() + static_cast<ptrdiff_t>(first);
+            };
+            uint32_t parent = open.empty() ? NONE : open.back();
+            // The first operand may be missing altogether
+            uint32_t offset = first < nodes.size()
+                                  ? nodes.starts[first]
+                                  : static_cast<uint32_t>(position());
+            nodes.kinds.insert(slot(nodes.kinds), kind);
+            nodes.starts.insert(slot(nodes.starts), offset);
+            nodes.ends.insert(slot(nodes.ends), offset);
+            nodes.parents.insert(slot(nodes.parents), parent);
+            nodes.subtreeEnds.insert(slot(nodes.subtreeEnds), first + 1);
+            // The nodes from `first` on are the first operand. Its root
+            // moves under the new node; its old parent may be a postfix
+            // wrapper's placeholder, so it is not shifted like the rest.
+            for (size_t i = first + 1; i < nodes.size(); ++i) {
+                uint32_t& up = nodes.parents[i];
+                up = i == first + 1 ? first : up + 1;
+                ++nodes.subtreeEnds[i];
+            }
+            open.push_back(first);
+            return first;
+        }
+
+        // Opens the wrappers of a postfix chain around the nodes from
+        // `first` on, innermost first in `wrappers`. Until now the children
+        // of wrappers[i] had WRAPPER - i for a parent.
+        void Parser::placeWrappers(uint32_t first,
+                                   const std::vector<Wrapper>& wrappers) {
+            auto count = static_cast<uint32_t>(wrappers.size());
+            auto slot = [first](auto& column) {
+                return column.begin() + static_cast<ptrdiff_t>(first);
+            };
+            // The outermost wrapper comes first, each one the parent of
+            // the next
+            uint32_t offset = nodes.starts[first];
+            std::vector<NodeKind> kinds;
+            std::vector<uint32_t> ends, parents, subtreeEnds;
+            for (uint32_t i = count; i-- > 0;) {
+                const Wrapper& wrapper = wrappers[i];
+                kinds.push_back(wrapper.kind);
+                ends.push_back(wrapper.end);
+                parents.push_back(i + 1 == count
+                                      ? (open.empty() ? NONE : open.back())
+                                      : first + (count - 2 - i));
+                subtreeEnds.push_back(wrapper.subtreeEnd + count);
+            }
+            nodes.kinds.insert(slot(nodes.kinds), kinds.begin(), kinds.end());
+            nodes.starts.insert(slot(nodes.starts), count, offset);
+            nodes.ends.insert(slot(nodes.ends), ends.begin(), ends.end());
+            nodes.parents.insert(slot(nodes.parents), parents.begin(),
+                                 parents.end());
+            nodes.subtreeEnds.insert(slot(nodes.subtreeEnds),
+                                     subtreeEnds.begin(), subtreeEnds.end());
+
+            // The chain's first operand goes under the innermost wrapper
+            nodes.parents[first + count] = first + count - 1;
+            for (size_t i = first + count + 1; i < nodes.size(); ++i) {
+                uint32_t& up = nodes.parents[i];
+                if (up > WRAPPER - count && up <= WRAPPER) {
+                    up = first + count - 1 - (WRAPPER - up);
+                } else if (up != NONE && up >= first) {
+                    up += count;
+                }
+                nodes.subtreeEnds[i] += count;
+            }
+            nodes.subtreeEnds[first + count] += count;
+        }
+
+        // Skips to the end of the line, or to the brace closing the
+        // enclosing block, under an Error node
+        void Parser::recover(const char* message) {
+            uint32_t from = end ? size : next.offset;
+            uint32_t node = start(NodeKind::Error);
+            int braces = 0;
+            while (!end) {
+                if (at(TokenKind::LBrace)) {
+                    ++braces;
+                } else if (at(TokenKind::RBrace)) {
+                    if (braces == 0) {
+                        break;
+                    }
+                    --braces;
+                } else if (braces == 0 && (at(TokenKind::Newline) ||
+                                           at(TokenKind::Semicolon))) {
+                    break;
+                }
+                advance();
+            }
+            finish(node);
+            errors.push_back({from, std::max(lastEnd, from) - from, message});
+        }
+
+        void Parser::parseItem() {
+            itemStart = next.offset;
+            if (at(TokenKind::RBrace)) {
+                uint32_t node = start(NodeKind::Error);
+                errors.push_back({next.offset, next.length, "unmatched '}'"});
+                advance();
+                finish(node);
+                return;
+            }
+            parseStatement();
+        }
+
+        void Parser::parseStatement() {
+            if (depth >= MAX_DEPTH) {
+                recover("nesting is too deep");
+                return;
+            }
+            ++depth;
+            switch (next.kind) {
+            case TokenKind::KwImport:
+                parseImport();
+                break;
+            case TokenKind::KwExport:
+                parseExport();
+                break;
+            case TokenKind::KwFn:
+                parseFunction();
+                break;
+            case TokenKind::KwStruct:
+                parseStruct();
+                break;
+            case TokenKind::KwVar:
+                parseVariable(NodeKind::Var);
+                break;
+            case TokenKind::KwConst:
+                parseVariable(NodeKind::Const);
+                break;
+            case TokenKind::KwIf:
+                parseIf();
+                break;
+            case TokenKind::KwWhile:
+                parseLoop(NodeKind::While);
+                break;
+            case TokenKind::KwFor:
+                parseLoop(NodeKind::For);
+                break;
+            case TokenKind::KwReturn: {
+                uint32_t node = start(NodeKind::Return);
+                advance();
+                if (!atStatementEnd()) {
+                    parseExpression();
+                }
+                endStatement();
+                finish(node);
+                break;
+            }
+            case TokenKind::KwBreak:
+            case TokenKind::KwContinue: {
+                uint32_t node = start(at(TokenKind::KwBreak)
+                                          ? NodeKind::Break
+                                          : NodeKind::Continue);
+                advance();
+                endStatement();
+                finish(node);
+                break;
+            }
+            case TokenKind::LBrace:
+                parseBlock();
+                break;
+            default:
+                if (!startsExpression()) {
+                    recover("unexpected token");
+                    break;
+                }
+                uint32_t node = start(NodeKind::ExprStmt);
+                parseExpression();
+                endStatement();
+                finish(node);
+                break;
+            }
+            --depth;
+        }
+
+        void Parser::parseImport() {
+            uint32_t node = start(NodeKind::Import);
+            advance();
+            // A missing module name is left to the diagnostics, which
+            // have a dedicated message for it
+            if (at(TokenKind::Identifier)) {
+                leaf(NodeKind::Name);
+                while (at(TokenKind::Dot) &&
+                       peekIs(1, TokenKind::Identifier)) {
+                    advance();
+                    leaf(NodeKind::Name);
+                }
+                if (eat(TokenKind::KwAs)) {
+                    parseName("expected a name after 'as'");
+                }
+            }
+            endStatement();
+            finish(node);
+        }
+
+        void Parser::parseExport() {
+            uint32_t node = start(NodeKind::Export);
+            advance();
+            if (at(TokenKind::KwFn) || at(TokenKind::KwStruct) ||
+                at(TokenKind::KwVar) || at(TokenKind::KwConst)) {
+                parseStatement();
+            } else {
+                expected("expected a declaration after 'export'");
+                endStatement();
+            }
+            finish(node);
+        }
+
+        void Parser::parseFunction() {
+            uint32_t node = start(NodeKind::Function);
+            advance();
+            parseName("expected a function name");
+            parseParams();
+            if (atOperator("->")) {
+                advance();
+                parseType();
+            }
+            parseBody();
+            finish(node);
+        }
+
+        void Parser::parseParams() {
+            if (!at(TokenKind::LParen)) {
+                expected("expected '('");
+                return;
+            }
+            uint32_t node = start(NodeKind::ParamList);
+            advance();
+            skipNewlines();
+            while (at(TokenKind::Identifier)) {
+                uint32_t param = start(NodeKind::Param);
+                leaf(NodeKind::Name);
+                if (eat(TokenKind::Colon)) {
+                    parseType();
+                }
+                finish(param);
+                skipNewlines();
+                if (!eat(TokenKind::Comma)) {
+                    break;
+                }
+                skipNewlines();
+            }
+            expect(TokenKind::RParen, "expected ')'");
+            finish(node);
+        }
+
+        void Parser::parseStruct() {
+            uint32_t node = start(NodeKind::Struct);
+            advance();
+            parseName("expected a struct name");
+            if (!eat(TokenKind::LBrace)) {
+                expected("expected '{'");
+                endStatement();
+                finish(node);
+                return;
+            }
+            while (true) {
+                while (at(TokenKind::Newline) || at(TokenKind::Semicolon) ||
+                       at(TokenKind::Comma)) {
+                    advance();
+                }
+                if (eat(TokenKind::RBrace)) {
+                    break;
+                }
+                if (end) {
+                    expected("expected '}'");
+                    break;
+                }
+                if (!at(TokenKind::Identifier)) {
+                    recover("expected a field name");
+                    continue;
+                }
+                uint32_t field = start(NodeKind::Field);
+                leaf(NodeKind::Name);
+                if (eat(TokenKind::Colon)) {
+                    parseType();
+                }
+                if (!atStatementEnd() && !at(TokenKind::Comma)) {
+                    recover("expected end of field");
+                }
+                finish(field);
+            }
+            finish(node);
+        }
+
+        void Parser::parseVariable(NodeKind kind) {
+            uint32_t node = start(kind);
+            advance();
+            parseName("expected a variable name");
+            if (eat(TokenKind::Colon)) {
+                parseType();
+            }
+            if (atOperator("=")) {
+                advance();
+                skipNewlines();
+                parseExpression();
+            }
+            endStatement();
+            finish(node);
+        }
+
+        void Parser::parseIf() {
+            uint32_t node = start(NodeKind::If);
+            advance();
+            parseExpression();
+            parseBody();
+            while (true) {
+                // elif and else may start on a later line
+                size_t ahead = 0;
+                while (peekIs(ahead, TokenKind::Newline)) {
+                    ++ahead;
+                }
+                bool isElif = peekIs(ahead, TokenKind::KwElif);
+                if (!isElif && !peekIs(ahead, TokenKind::KwElse)) {
+                    break;
+                }
+                skipNewlines();
+                uint32_t branch =
+                    start(isElif ? NodeKind::Elif : NodeKind::Else);
+                advance();
+                if (isElif) {
+                    parseExpression();
+                }
+                parseBody();
+                finish(branch);
+                if (!isElif) {
+                    break;
+                }
+            }
+            finish(node);
+        }
+
+        void Parser::parseLoop(NodeKind kind) {
+            uint32_t node = start(kind);
+            advance();
+            if (kind == NodeKind::For) {
+                parseName("expected a loop variable");
+                if (!eat(TokenKind::KwIn)) {
+                    expected("expected 'in'");
+                }
+            }
+            parseExpression();
+            parseBody();
+            finish(node);
+        }
+
+        void Parser::parseBody() {
+            if (at(TokenKind::LBrace)) {
+                parseBlock();
+                return;
+            }
+            expected("expected '{'");
+            endStatement();
+        }
+
+        void Parser::parseBlock() {
+            uint32_t node = start(NodeKind::Block);
+            advance();
+            while (true) {
+                skipSeparators();
+                if (eat(TokenKind::RBrace)) {
+                    break;
+                }
+                if (end) {
+                    expected("expected '}'");
+                    break;
+                }
+                parseStatement();
+            }
+            finish(node);
+        }
+
+        void Parser::parseType() {
+            if (depth >= MAX_DEPTH) {
+                recover("type is nested too deeply");
+                return;
+            }
+            ++depth;
+            uint32_t node = start(NodeKind::Type);
+            if (at(TokenKind::Identifier)) {
+                leaf(NodeKind::Name);
+                while (at(TokenKind::Dot) &&
+                       peekIs(1, TokenKind::Identifier)) {
+                    advance();
+                    leaf(NodeKind::Name);
+                }
+            } else if (eat(TokenKind::LBracket)) {
+                size_t reported = errors.size();
+                parseType();
+                // A nested type that failed already said what was wrong
+                if (errors.size() == reported) {
+                    expect(TokenKind::RBracket, "expected ']'");
+                } else {
+                    eat(TokenKind::RBracket);
+                }
+            } else {
+                expected("expected a type");
+            }
+            finish(node);
+            --depth;
+        }
+
+        bool Parser::startsExpression() const {
+            if (end) {
+                return false;
+            }
+            switch (next.kind) {
+            case TokenKind::Identifier:
+            case TokenKind::Number:
+            case TokenKind::String:
+            case TokenKind::KwTrue:
+            case TokenKind::KwFalse:
+            case TokenKind::LParen:
+            case TokenKind::LBracket:
+            case TokenKind::Operator:
+                return true;
+            default:
+                return false;
+            }
+        }
+
+        void Parser::parseExpression() {
+            auto first = static_cast<uint32_t>(nodes.size());
+            parseUnary();
+            uint32_t chain = NONE;
+            while (at(TokenKind::Operator) && !atOperator("->")) {
+                if (chain == NONE) {
+                    chain = precede(first, NodeKind::Binary);
+                }
+                advance();
+                skipNewlines();
+                parseUnary();
+            }
+            if (chain != NONE) {
+                finish(chain);
+            }
+        }
+
+        void Parser::parseUnary() {
+            if (depth >= MAX_DEPTH) {
+                expected("expression is nested too deeply");
+                if (!atStatementEnd()) {
+                    advance();
+                }
+                return;
+            }
+            ++depth;
+            if (at(TokenKind::Operator)) {
+                uint32_t node = start(NodeKind::Unary);
+                advance();
+                parseUnary();
+                finish(node);
+            } else {
+                parsePostfix();
+            }
+            --depth;
+        }
+
+        void Parser::parsePostfix() {
+            auto first = static_cast<uint32_t>(nodes.size());
+            if (!parsePrimary()) {
+                return;
+            }
+            // Each operator wraps the chain so far. Wrapping in place
+            // would shift the whole chain once per operator, so the
+            // wrappers are placed in one go once the chain ends.
+            std::vector<Wrapper> wrappers;
+            while (true) {
+                NodeKind kind;
+                if (at(TokenKind::Dot)) {
+                    kind = NodeKind::Member;
+                } else if (at(TokenKind::LParen)) {
+                    kind = NodeKind::Call;
+                } else if (at(TokenKind::LBracket)) {
+                    kind = NodeKind::Index;
+                } else {
+                    break;
+                }
+                open.push_back(WRAPPER -
+                               static_cast<uint32_t>(wrappers.size()));
+                if (kind == NodeKind::Member) {
+                    advance();
+                    parseName("expected a member name");
+                } else if (kind == NodeKind::Call) {
+                    parseSequence(NodeKind::ArgList, TokenKind::RParen,
+                                  "expected ')'");
+                } else {
+                    advance();
+                    skipNewlines();
+                    parseExpression();
+                    skipNewlines();
+                    expect(TokenKind::RBracket, "expected ']'");
+                }
+                open.pop_back();
+                wrappers.push_back({kind,
+                                    std::max(lastEnd, nodes.starts[first]),
+                                    static_cast<uint32_t>(nodes.size())});
+            }
+            if (!wrappers.empty()) {
+                placeWrappers(first, wrappers);
+            }
+        }
+
+        bool Parser::parsePrimary() {
+            switch (end ? TokenKind::Unknown : next.kind) {
+            case TokenKind::Identifier:
+                leaf(NodeKind::Name);
+                return true;
+            case TokenKind::Number:
+            case TokenKind::String:
+            case TokenKind::KwTrue:
+            case TokenKind::KwFalse:
+                leaf(NodeKind::Literal);
+                return true;
+            case TokenKind::LParen: {
+                uint32_t node = start(NodeKind::Paren);
+                advance();
+                skipNewlines();
+                parseExpression();
+                skipNewlines();
+                expect(TokenKind::RParen, "expected ')'");
+                finish(node);
+                return true;
+            }
+            case TokenKind::LBracket:
+                parseSequence(NodeKind::List, TokenKind::RBracket,
+                              "expected ']'");
+                return true;
+            default:
+                expected("expected an expression");
+                return false;
+            }
+        }
+
+        // Comma-separated expressions between the current token and
+        // `close`
+        void Parser::parseSequence(NodeKind kind, TokenKind close,
+                                   const char* message) {
+            uint32_t node = start(kind);
+            advance();
+            skipNewlines();
+            while (startsExpression()) {
+                parseExpression();
+                skipNewlines();
+                if (!eat(TokenKind::Comma)) {
+                    break;
+                }
+                skipNewlines();
+            }
+            expect(close, message);
+            finish(node);
+        }
+
+        // Parses items into chunks appended to `pieces` until the end of
+        // the text or until `stop(position)` holds between two items
+        template <typename Stop>
+        void parseItems(const Rope& text, const TokenList& tokens,
+                        size_t from, std::vector<SyntaxTree::Piece>& pieces,
+                        Stop&& stop) {
+            // Only the chunk being filled is held here, and the storage is
+            // kept for the next parse on this thread
+            thread_local NodeColumns nodes;
+            thread_local std::vector<SyntaxError> errors;
+            nodes.clear();
+            errors.clear();
+            Parser parser(text, tokens, from, nodes, errors);
+
+            auto flush = [&] {
+                if (nodes.size() == 0) {
+                    return;
+                }
+                uint32_t offset = nodes.starts[0];
+                pieces.push_back({std::make_shared<const SyntaxChunk>(
+                                      nodes, 0, nodes.size(), errors.data(),
+                                      errors.size(), offset),
+                                  offset});
+                nodes.clear();
+                errors.clear();
+            };
+
+            while (true) {
+                parser.skipSeparators();
+                if (parser.atEnd() || stop(parser.position())) {
+                    break;
+                }
+                parser.parseItem();
+                if (nodes.size() >= CHUNK_NODES) {
+                    flush();
+                }
+            }
+            flush();
+        }
+    } // namespace
+
+    std::shared_ptr<const SyntaxTree> parseSyntax(const Rope& text,
+                                                  const TokenList& tokens) {
+        std::vector<SyntaxTree::Piece> pieces;
+        parseItems(text, tokens, 0, pieces, [](size_t) { return false; });
+        return std::make_shared<const SyntaxTree>(std::move(pieces));
+    }
+
+    std::shared_ptr<const SyntaxTree>
+    reparseSyntax(const SyntaxTree& previous, const Rope& text,
+                  const TokenList& tokens, const EditSpan& edit) {
+        const std::vector<SyntaxTree::Piece>& old = previous.chunks();
+
+        // Chunks ending before the edit are unaffected, except for the
+        // last of them: its last item may go on past the lines between,
+        // as an `if` does with an `else` typed after it. Parsing restarts
+        // at that chunk, so the item is read again with what follows.
+        auto first = std::partition_point(
+            old.begin(), old.end(), [&](const SyntaxTree::Piece& piece) {
+                return piece.offset + piece.chunk->length() < edit.start;
+            });
+        if (first != old.begin()) {
+            --first;
+        }
+        size_t from = first != old.begin()
+                          ? (first - 1)->offset + (first - 1)->chunk->length()
+                          : 0;
+
+        std::vector<SyntaxTree::Piece> pieces(old.begin(), first);
+        pieces.reserve(old.size() + 1);
+
+        // Chunks starting after the edit parse the same once the parser
+        // is back at their first token, so parsing stops there
+        auto reuse = std::partition_point(
+            first, old.end(), [&](const SyntaxTree::Piece& piece) {
+                return piece.offset <= edit.oldEnd;
+            });
+        auto shifted = [&](const SyntaxTree::Piece& piece) {
+            return piece.offset - edit.oldEnd + edit.newEnd;
+        };
+        bool synced = false;
+        parseItems(text, tokens, from, pieces, [&](size_t position) {
+            while (reuse != old.end() && shifted(*reuse) < position) {
+                ++reuse;
+            }
+            synced = reuse != old.end() && shifted(*reuse) == position;
+            return synced;
+        });
+
+        if (synced) {
+            for (; reuse != old.end(); ++reuse) {
+                pieces.push_back({reuse->chunk, shifted(*reuse)});
+            }
+        }
+        return std::make_shared<const SyntaxTree>(std::move(pieces));
+    }
+} // namespace lsp
@@ -0,0 +1,99 @@
+#include "PublishedDiagnostics.h"
+#include <cstdio>
+
+namespace lsp {
+
+    namespace {
+
+        // FNV-1a, fed field by field
+        class Hasher {
+          public:
+            void add(std::string_view bytes) {
+                for (unsigned char c : bytes) {
+                    addByte(c);
+                }
+                // Ends each string, so "ab" + "c" and "a" + "bc" differ
+                addByte(0xFF);
+            }
+            void add(int64_t value) {
+                for (int i = 0; i < 8; ++i) {
+                    addByte(static_cast<unsigned char>(value >> (i * 8)));
+                }
+            }
+            uint64_t value() const {
+                return state;
+            }
+
+          private:
+            uint64_t state = 0xcbf29ce484222325ULL;
+
+            void addByte(unsigned char c) {
+                state = (state ^ c) * 0x100000001b3ULL;
+            }
+        };
+    } // namespace
+
+    uint64_t diagnosticsHash(const std::vector<Diagnostic>& diagnostics) {
+        Hasher hasher;
+        hasher.add(static_cast<int64_t>(diagnostics.size()));
+        for (const Diagnostic& diagnostic : diagnostics) {
+            hasher.add(int64_t{diagnostic.range.start.line});
+            hasher.add(int64_t{diagnostic.range.start.character});
+            hasher.add(int64_t{diagnostic.range.end.line});
+            hasher.add(int64_t{diagnostic.range.end.character});
+            hasher.add(static_cast<int64_t>(diagnostic.severity));
+            hasher.add(diagnostic.message);
+            hasher.add(diagnostic.source);
+            hasher.add(int64_t{diagnostic.code.has_value()});
+            if (diagnostic.code) {
+                hasher.add(*diagnostic.code);
+            }
+        }
+        return hasher.value();
+    }
+
+    std::string diagnosticsResultId(uint64_t hash) {
+        char id[17];
+        std::snprintf(id, sizeof(id), "%016llx",
+                      static_cast<unsigned long long>(hash));
+        return id;
+    }
+
+    bool PublishedDiagnostics::update(std::string_view uri, int version,
+                                      uint64_t hash) {
+        std::lock_guard lock(mutex);
+        auto it = entries.find(uri);
+        if (it == entries.end()) {
+            entries.emplace(std::string(uri), Entry{version, hash});
+            return true;
+        }
+        Entry& last = it->second;
+        if (version < last.version) {
+            return false;
+        }
+        last.version = version;
+        if (last.hash == hash) {
+            return false;
+        }
+        last.hash = hash;
+        return true;
+    }
+
+    std::optional<PublishedDiagnostics::Entry>
+    PublishedDiagnostics::find(std::string_view uri) const {
+        std::lock_guard lock(mutex);
+        auto it = entries.find(uri);
+        if (it == entries.end()) {
+            return std::nullopt;
+        }
+        return it->second;
+    }
+
+    void PublishedDiagnostics::forget(std::string_view uri) {
+        std::lock_guard lock(mutex);
+        auto it = entries.find(uri);
+        if (it != entries.end()) {
+            entries.erase(it);
+        }
+    }
+} // namespace lsp
@@ -0,0 +1,33 @@
+#include "ResolveTable.h"
+
+namespace lsp {
+
+    ResolveTable::ResolveTable(size_t capacity) : slots(capacity) {}
+
+    uint64_t ResolveTable::add(std::string_view uri, int version,
+                               const CompletionResult& result) {
+        std::lock_guard lock(mutex);
+        uint64_t handle = nextHandle++;
+        Slot& slot = slots[handle % slots.size()];
+        slot.handle = handle;
+        slot.uri.assign(uri);
+        slot.version = version;
+        // Reuses the evicted result's storage
+        slot.entries.assign(result.entries.begin(), result.entries.end());
+        slot.owner = result.owner;
+        return handle;
+    }
+
+    std::optional<ResolveTable::Item>
+    ResolveTable::find(uint64_t handle, uint32_t index) const {
+        std::lock_guard lock(mutex);
+        const Slot& slot = slots[handle % slots.size()];
+        if (handle == 0 || slot.handle != handle ||
+            index >= slot.entries.size()) {
+            return std::nullopt;
+        }
+        const CompletionEntry& entry = slot.entries[index];
+        return Item{entry.cache, entry.item, slot.uri, slot.version,
+                    slot.owner};
+    }
+} // namespace lsp
@@ -0,0 +1,289 @@
+#include "Rope.h"
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+    // Chunks are cut at this size when building from text, and small edits
+    // are folded into their neighbours as long as the result stays below
+    // MAX_CHUNK, so typing does not leave a trail of one-character nodes.
+    constexpr size_t CHUNK_SIZE = 1024;
+    constexpr size_t MAX_CHUNK = 2 * CHUNK_SIZE;
+
+    uint32_t randomPriority() {
+        thread_local uint32_t state = 0x9e3779b9u;
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+} // namespace
+
+namespace lsp {
+
+    Rope::Rope(std::string_view text) : root(build(text)) {}
+
+    size_t Rope::size() const {
+        return length(root);
+    }
+
+    Rope::NodePtr Rope::make(NodePtr left, std::string chunk, NodePtr right,
+                             uint32_t priority) {
+        size_t total = length(left) + chunk.size() + length(right);
+        return std::make_shared<const Node>(Node{std::move(left),
+                                                 std::move(right),
+                                                 std::move(chunk), total,
+                                                 priority});
+    }
+
+    Rope::NodePtr Rope::build(std::string_view text) {
+        if (text.empty()) {
+            return nullptr;
+        }
+
+        // Cartesian tree over the chunks: a linear-time build that yields
+        // the same shape as inserting them one by one into the treap
+        struct Pending {
+            std::string chunk;
+            uint32_t priority;
+            NodePtr left;
+            NodePtr right;
+        };
+        auto finish = [](Pending& p) {
+            return make(std::move(p.left), std::move(p.chunk),
+                        std::move(p.right), p.priority);
+        };
+
+        std::vector<Pending> stack;
+        for (size_t pos = 0; pos < text.size(); pos += CHUNK_SIZE) {
+            Pending current{std::string(text.substr(pos, CHUNK_SIZE)),
+                            randomPriority(), nullptr, nullptr};
+            NodePtr popped;
+            while (!stack.empty() &&
+                   stack.back().priority < current.priority) {
+                stack.back().right = std::move(popped);
+                popped = finish(stack.back());
+                stack.pop_back();
+            }
+            current.left = std::move(popped);
+            stack.push_back(std::move(current));
+        }
+
+        NodePtr result;
+        while (!stack.empty()) {
+            stack.back().right = std::move(result);
+            result = finish(stack.back());
+            stack.pop_back();
+        }
+        return result;
+    }
+
+    std::pair<Rope::NodePtr, Rope::NodePtr> Rope::split(const NodePtr& node,
+                                                        size_t offset) {
+        if (!node) {
+            return {nullptr, nullptr};
+        }
+        if (offset == 0) {
+            return {nullptr, node};
+        }
+        if (offset >= node->length) {
+            return {node, nullptr};
+        }
+
+        size_t leftLength = length(node->left);
+        if (offset <= leftLength) {
+            auto [a, b] = split(node->left, offset);
+            return {a, make(b, node->chunk, node->right, node->priority)};
+        }
+
+        offset -= leftLength;
+        if (offset >= node->chunk.size()) {
+            auto [a, b] = split(node->right, offset - node->chunk.size());
+            return {make(node->left, node->chunk, a, node->priority), b};
+        }
+
+        // The split point falls inside this node's chunk
+        return {make(node->left, node->chunk.substr(0, offset), nullptr,
+                     node->priority),
+                make(nullptr, node->chunk.substr(offset), node->right,
+                     node->priority)};
+    }
+
+    Rope::NodePtr Rope::merge(const NodePtr& a, const NodePtr& b) {
+        if (!a) {
+            return b;
+        }
+        if (!b) {
+            return a;
+        }
+        if (a->priority > b->priority) {
+            return make(a->left, a->chunk, merge(a->right, b), a->priority);
+        }
+        return make(merge(a, b->left), b->chunk, b->right, b->priority);
+    }
+
+    const Rope::Node* Rope::first(const Node* node) {
+        while (node && node->left) {
+            node = node->left.get();
+        }
+        return node;
+    }
+
+    const Rope::Node* Rope::last(const Node* node) {
+        while (node && node->right) {
+            node = node->right.get();
+        }
+        return node;
+    }
+
+    Rope Rope::replace(size_t offset, size_t length,
+                       std::string_view text) const {
+        size_t total = size();
+        offset = std::min(offset, total);
+        length = std::min(length, total - offset);
+
+        auto [before, rest] = split(root, offset);
+        NodePtr after = split(rest, length).second;
+
+        // Fold the edit into the chunks on either side of it while the
+        // combined chunk stays small
+        std::string middle(text);
+        if (middle.size() < MAX_CHUNK) {
+            const Node* prev = last(before.get());
+            if (prev && prev->chunk.size() + middle.size() <= MAX_CHUNK) {
+                middle.insert(0, prev->chunk);
+                before = split(before, Rope::length(before) - prev->chunk.size())
+                             .first;
+            }
+            const Node* next = first(after.get());
+            if (next && next->chunk.size() + middle.size() <= MAX_CHUNK) {
+                middle += next->chunk;
+                after = split(after, next->chunk.size()).second;
+            }
+        }
+
+        return Rope(merge(merge(before, build(middle)), after));
+    }
+
+    char Rope::at(size_t offset) const {
+        const Node* node = root.get();
+        while (node) {
+            size_t leftLength = length(node->left);
+            if (offset < leftLength) {
+                node = node->left.get();
+                continue;
+            }
+            offset -= leftLength;
+            if (offset < node->chunk.size()) {
+                return node->chunk[offset];
+            }
+            offset -= node->chunk.size();
+            node = node->right.get();
+        }
+        return '\0';
+    }
+
+    std::string Rope::substr(size_t offset, size_t length) const {
+        std::string result;
+        if (offset >= size()) {
+            return result;
+        }
+        length = std::min(length, size() - offset);
+        result.reserve(length);
+
+        // Only the chunks overlapping the range are visited
+        forEachChunk(offset, length, [&](std::string_view chunk) {
+            result.append(chunk);
+            return true;
+        });
+        return result;
+    }
+
+    class Rope::Cursor {
+      public:
+        Cursor(const Node* node, size_t offset) {
+            while (node) {
+                size_t leftLength = length(node->left);
+                if (offset < leftLength) {
+                    pending.push_back(node);
+                    node = node->left.get();
+                    continue;
+                }
+                offset -= leftLength;
+                if (offset < node->chunk.size()) {
+                    current = std::string_view(node->chunk).substr(offset);
+                    pushLeftmost(node->right.get());
+                    return;
+                }
+                offset -= node->chunk.size();
+                node = node->right.get();
+            }
+        }
+
+        // The rest of the chunk the cursor is in; empty at the end
+        std::string_view chunk() const {
+            return current;
+        }
+
+        void advance(size_t count) {
+            current.remove_prefix(count);
+            if (current.empty() && !pending.empty()) {
+                const Node* node = pending.back();
+                pending.pop_back();
+                current = node->chunk;
+                pushLeftmost(node->right.get());
+            }
+        }
+
+      private:
+        // Nodes whose chunk comes later, nearest last
+        std::vector<const Node*> pending;
+        std::string_view current;
+
+        void pushLeftmost(const Node* node) {
+            for (; node; node = node->left.get()) {
+                pending.push_back(node);
+            }
+        }
+    };
+
+    bool Rope::sameText(size_t offset, const Rope& other, size_t otherOffset,
+                        size_t length) const {
+        if (offset > size() || length > size() - offset ||
+            otherOffset > other.size() || length > other.size() - otherOffset) {
+            return false;
+        }
+        if (root == other.root && offset == otherOffset) {
+            return true;
+        }
+        Cursor a(root.get(), offset);
+        Cursor b(other.root.get(), otherOffset);
+        while (length > 0) {
+            std::string_view x = a.chunk();
+            std::string_view y = b.chunk();
+            size_t count = std::min({x.size(), y.size(), length});
+            if (count == 0) {
+                return false;
+            }
+            // A shared chunk holds the same bytes at the same address
+            if (x.data() != y.data() &&
+                x.substr(0, count) != y.substr(0, count)) {
+                return false;
+            }
+            a.advance(count);
+            b.advance(count);
+            length -= count;
+        }
+        return true;
+    }
+
+    std::string Rope::toString() const {
+        std::string result;
+        result.reserve(size());
+        forEachChunk([&](std::string_view chunk) {
+            result.append(chunk);
+            return true;
+        });
+        return result;
+    }
+} // namespace lsp
@@ -0,0 +1,138 @@
+#include "Scheduler.h"
+#include "Logger.h"
+#include <algorithm>
+
+namespace lsp {
+
+    Scheduler::Scheduler(size_t workerCount) {
+        if (workerCount == 0) {
+            workerCount = std::max(2u, std::thread::hardware_concurrency());
+        }
+        workers.reserve(workerCount);
+        for (size_t i = 0; i < workerCount; ++i) {
+            workers.emplace_back([this] { workerLoop(); });
+        }
+    }
+
+    Scheduler::~Scheduler() {
+        shutdown();
+    }
+
+    void Scheduler::submit(Task task) {
+        {
+            std::lock_guard lock(mutex);
+            if (task.sequential) {
+                sequentialQueue.push_back(
+                    {std::move(task.run), submittedSequential, false});
+                ++submittedSequential;
+            } else {
+                size_t index = std::min<size_t>(
+                    static_cast<size_t>(task.priority),
+                    parallelQueues.size() - 1);
+                parallelQueues[index].push_back(
+                    {std::move(task.run), submittedSequential, task.detached});
+                if (!task.detached) {
+                    ++pendingParallel[submittedSequential];
+                }
+            }
+        }
+        ready.notify_one();
+    }
+
+    void Scheduler::shutdown() {
+        {
+            std::lock_guard lock(mutex);
+            if (stopping) {
+                return;
+            }
+            stopping = true;
+        }
+        ready.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        workers.clear();
+    }
+
+    bool Scheduler::sequentialReady() const {
+        if (sequentialRunning || sequentialQueue.empty()) {
+            return false;
+        }
+        // Parallel tasks submitted before this one must have finished
+        uint64_t barrier = sequentialQueue.front().barrier;
+        return pendingParallel.empty() ||
+               pendingParallel.begin()->first > barrier;
+    }
+
+    bool Scheduler::idle() const {
+        if (sequentialRunning || !sequentialQueue.empty()) {
+            return false;
+        }
+        return std::all_of(parallelQueues.begin(), parallelQueues.end(),
+                           [](const auto& queue) { return queue.empty(); });
+    }
+
+    void Scheduler::workerLoop() {
+        std::unique_lock lock(mutex);
+        while (true) {
+            std::function<void()> run;
+            bool sequential = false;
+            bool counted = false;
+            uint64_t barrier = 0;
+
+            if (sequentialReady()) {
+                run = std::move(sequentialQueue.front().run);
+                sequentialQueue.pop_front();
+                sequentialRunning = true;
+                sequential = true;
+            } else {
+                // Highest priority first; each queue is ordered by barrier
+                // so only its head needs checking
+                for (auto queue = parallelQueues.rbegin();
+                     queue != parallelQueues.rend(); ++queue) {
+                    if (!queue->empty() &&
+                        queue->front().barrier <= completedSequential) {
+                        run = std::move(queue->front().run);
+                        barrier = queue->front().barrier;
+                        counted = !queue->front().detached;
+                        queue->pop_front();
+                        break;
+                    }
+                }
+            }
+
+            if (!run) {
+                if (stopping && idle()) {
+                    return;
+                }
+                ready.wait(lock);
+                continue;
+            }
+
+            lock.unlock();
+            try {
+                run();
+            } catch (const std::exception& e) {
+                LSP_LOG(Error, "Scheduler") << "Task failed: " << e.what();
+            }
+            lock.lock();
+
+            if (sequential) {
+                sequentialRunning = false;
+                ++completedSequential;
+                // Unblocks the next sequential task and any parallel tasks
+                // that were waiting on this one
+                ready.notify_all();
+            } else if (counted) {
+                auto pending = pendingParallel.find(barrier);
+                if (--pending->second == 0) {
+                    pendingParallel.erase(pending);
+                    ready.notify_all();
+                }
+            }
+            if (stopping && idle()) {
+                ready.notify_all();
+            }
+        }
+    }
+} // namespace lsp
@@ -0,0 +1,139 @@
+#include "SessionTrace.h"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+    template <typename T> void put(std::string& out, T value) {
+        char bytes[sizeof(T)];
+        std::memcpy(bytes, &value, sizeof(T));
+        out.append(bytes, sizeof(T));
+    }
+
+    template <typename T> bool get(std::FILE* file, T& value) {
+        return std::fread(&value, sizeof(T), 1, file) == 1;
+    }
+} // namespace
+
+namespace lsp {
+
+    TraceRecorder::TraceRecorder(const std::string& path)
+        : file(std::fopen(path.c_str(), "wb")),
+          start(std::chrono::steady_clock::now()) {
+        if (file == nullptr) {
+            throw std::runtime_error("cannot create trace file " + path +
+                                     ": " + std::strerror(errno));
+        }
+        pending.append(TRACE_MAGIC);
+        put(pending, TRACE_FORMAT_VERSION);
+        thread = std::thread([this] { loop(); });
+    }
+
+    TraceRecorder::~TraceRecorder() {
+        close();
+    }
+
+    void TraceRecorder::record(TraceDirection direction,
+                               std::string_view body) {
+        auto nanoseconds = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start)
+                .count());
+        bool wasEmpty;
+        {
+            std::lock_guard lock(mutex);
+            if (stopping) {
+                return;
+            }
+            wasEmpty = pending.empty();
+            put(pending, static_cast<uint8_t>(direction));
+            put(pending, nanoseconds);
+            put(pending, static_cast<uint32_t>(body.size()));
+            pending.append(body);
+        }
+        if (wasEmpty) {
+            wake.notify_one();
+        }
+    }
+
+    void TraceRecorder::close() {
+        {
+            std::lock_guard lock(mutex);
+            if (stopping) {
+                return;
+            }
+            stopping = true;
+        }
+        wake.notify_one();
+        thread.join();
+        std::fclose(file);
+    }
+
+    void TraceRecorder::loop() {
+        std::string batch;
+        std::unique_lock lock(mutex);
+        while (true) {
+            wake.wait(lock, [&] { return stopping || !pending.empty(); });
+            batch.swap(pending);
+            bool stop = stopping;
+            lock.unlock();
+
+            std::fwrite(batch.data(), 1, batch.size(), file);
+            batch.clear();
+            if (stop) {
+                std::fflush(file);
+                return;
+            }
+            lock.lock();
+        }
+    }
+
+    bool isTraceFile(const std::string& path) {
+        std::FILE* file = std::fopen(path.c_str(), "rb");
+        if (file == nullptr) {
+            return false;
+        }
+        char magic[TRACE_MAGIC.size()];
+        bool matches = std::fread(magic, 1, sizeof magic, file) ==
+                           sizeof magic &&
+                       std::string_view(magic, sizeof magic) == TRACE_MAGIC;
+        std::fclose(file);
+        return matches;
+    }
+
+    std::vector<TraceRecord> loadTrace(const std::string& path) {
+        std::FILE* file = std::fopen(path.c_str(), "rb");
+        if (file == nullptr) {
+            throw std::runtime_error("cannot open trace file " + path);
+        }
+
+        char magic[TRACE_MAGIC.size()];
+        uint32_t version = 0;
+        if (std::fread(magic, 1, sizeof magic, file) != sizeof magic ||
+            std::string_view(magic, sizeof magic) != TRACE_MAGIC ||
+            !get(file, version) || version != TRACE_FORMAT_VERSION) {
+            std::fclose(file);
+            throw std::runtime_error(path + " is not a session trace");
+        }
+
+        std::vector<TraceRecord> records;
+        while (true) {
+            uint8_t direction;
+            uint64_t nanoseconds;
+            uint32_t length;
+            if (!get(file, direction) || !get(file, nanoseconds) ||
+                !get(file, length)) {
+                break;
+            }
+            TraceRecord record{static_cast<TraceDirection>(direction),
+                               nanoseconds, std::string(length, '\0')};
+            if (std::fread(record.body.data(), 1, length, file) != length) {
+                break;
+            }
+            records.push_back(std::move(record));
+        }
+        std::fclose(file);
+        return records;
+    }
+} // namespace lsp
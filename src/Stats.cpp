@@ -0,0 +1,74 @@
+#include "Stats.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+namespace lsp {
+
+    size_t LatencyHistogram::bucketOf(uint64_t value) {
+        if (value < SUB_BUCKETS) {
+            return static_cast<size_t>(value);
+        }
+        // Top SUB_BUCKET_BITS + 1 significant bits pick the bucket
+        unsigned magnitude = 63 - std::countl_zero(value);
+        unsigned shift = magnitude - SUB_BUCKET_BITS;
+        size_t sub = static_cast<size_t>(value >> shift) & (SUB_BUCKETS - 1);
+        return (shift + 1) * SUB_BUCKETS + sub;
+    }
+
+    uint64_t LatencyHistogram::bucketStart(size_t index) {
+        if (index < SUB_BUCKETS) {
+            return index;
+        }
+        unsigned shift = static_cast<unsigned>(index / SUB_BUCKETS) - 1;
+        uint64_t sub = index % SUB_BUCKETS;
+        return (SUB_BUCKETS + sub) << shift;
+    }
+
+    void LatencyHistogram::record(uint64_t nanoseconds) {
+        buckets[bucketOf(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+        total.fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(nanoseconds, std::memory_order_relaxed);
+
+        uint64_t seen = max.load(std::memory_order_relaxed);
+        while (nanoseconds > seen &&
+               !max.compare_exchange_weak(seen, nanoseconds,
+                                          std::memory_order_relaxed)) {
+        }
+    }
+
+    uint64_t LatencyHistogram::percentile(double q) const {
+        uint64_t n = count();
+        if (n == 0) {
+            return 0;
+        }
+        // Nearest-rank: the ceil(q * n)-th smallest sample, 1-based
+        uint64_t rank =
+            static_cast<uint64_t>(std::ceil(q * static_cast<double>(n)));
+        rank = std::clamp<uint64_t>(rank, 1, n);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; ++i) {
+            seen += buckets[i].load(std::memory_order_relaxed);
+            if (seen >= rank) {
+                return bucketStart(i);
+            }
+        }
+        return max.load(std::memory_order_relaxed);
+    }
+
+    json LatencyHistogram::summary() const {
+        auto micros = [](uint64_t ns) { return static_cast<double>(ns) / 1000.0; };
+        uint64_t n = count();
+        return {{"count", n},
+                {"meanUs", n ? micros(sum.load(std::memory_order_relaxed)) / n
+                             : 0.0},
+                {"p50Us", micros(percentile(0.50))},
+                {"p90Us", micros(percentile(0.90))},
+                {"p99Us", micros(percentile(0.99))},
+                {"p999Us", micros(percentile(0.999))},
+                {"maxUs", micros(max.load(std::memory_order_relaxed))}};
+    }
+
+    ServerStats::ServerStats(size_t methodCount)
+        : methods(std::make_unique<MethodStats[]>(methodCount)) {}
+} // namespace lsp
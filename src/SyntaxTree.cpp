@@ -0,0 +1,120 @@
+#include "SyntaxTree.h"
+#include <algorithm>
+#include <cstring>
+
+namespace lsp {
+
+    void NodeColumns::clear() {
+        kinds.clear();
+        starts.clear();
+        ends.clear();
+        parents.clear();
+        subtreeEnds.clear();
+    }
+
+    SyntaxChunk::SyntaxChunk(const NodeColumns& nodes, size_t first,
+                             size_t last, const SyntaxError* errorList,
+                             size_t errorCount, uint32_t offset)
+        // Sized so the columns fit the first arena chunk exactly
+        : arena((last - first) * (sizeof(NodeKind) + 4 * sizeof(uint32_t)) +
+                errorCount * sizeof(SyntaxError) + 64),
+          count(static_cast<uint32_t>(last - first)),
+          textLength(last > first ? nodes.ends[first] - offset : 0),
+          errorTotal(static_cast<uint32_t>(errorCount)) {
+        starts = arena.allocateArray<uint32_t>(count);
+        ends = arena.allocateArray<uint32_t>(count);
+        parents = arena.allocateArray<uint32_t>(count);
+        subtreeEnds = arena.allocateArray<uint32_t>(count);
+        errors = arena.allocateArray<SyntaxError>(errorTotal);
+        kinds = arena.allocateArray<NodeKind>(count);
+
+        auto base = static_cast<uint32_t>(first);
+        std::memcpy(kinds, nodes.kinds.data() + first, count);
+        for (uint32_t i = 0; i < count; ++i) {
+            starts[i] = nodes.starts[first + i] - offset;
+            ends[i] = nodes.ends[first + i] - offset;
+            // Parents outside the range are the items' own parent
+            uint32_t parent = nodes.parents[first + i];
+            parents[i] = parent != NONE && parent >= base ? parent - base
+                                                         : NONE;
+            subtreeEnds[i] = nodes.subtreeEnds[first + i] - base;
+            if (parents[i] == NONE) {
+                textLength = ends[i];
+            }
+        }
+        for (uint32_t i = 0; i < errorTotal; ++i) {
+            errors[i] = errorList[i];
+            errors[i].offset -= offset;
+        }
+    }
+
+    SyntaxNode SyntaxNode::parent() const {
+        uint32_t parent = chunk->parent(index);
+        if (parent == SyntaxChunk::NONE) {
+            return {};
+        }
+        return {chunk, parent, base};
+    }
+
+    SyntaxNode SyntaxNode::firstChild() const {
+        if (index + 1 >= chunk->subtreeEnd(index)) {
+            return {};
+        }
+        return {chunk, index + 1, base};
+    }
+
+    SyntaxNode SyntaxNode::nextSibling() const {
+        uint32_t parent = chunk->parent(index);
+        uint32_t next = chunk->subtreeEnd(index);
+        if (parent == SyntaxChunk::NONE || next >= chunk->subtreeEnd(parent)) {
+            return {};
+        }
+        return {chunk, next, base};
+    }
+
+    SyntaxNode SyntaxNode::child(NodeKind kind) const {
+        for (SyntaxNode node = firstChild(); node; node = node.nextSibling()) {
+            if (node.kind() == kind) {
+                return node;
+            }
+        }
+        return {};
+    }
+
+    SyntaxNode SyntaxTree::nodeAt(size_t offset) const {
+        // Last chunk starting at or before the offset
+        auto piece = std::upper_bound(
+            pieces.begin(), pieces.end(), offset,
+            [](size_t value, const Piece& p) { return value < p.offset; });
+        if (piece == pieces.begin()) {
+            return {};
+        }
+        --piece;
+        const SyntaxChunk& chunk = *piece->chunk;
+        if (offset - piece->offset > chunk.length()) {
+            return {};
+        }
+        auto local = static_cast<uint32_t>(offset - piece->offset);
+
+        // Descends through the first node containing the offset at each
+        // level, so a position between two tokens lands on the one before
+        uint32_t found = SyntaxChunk::NONE;
+        uint32_t i = 0;
+        uint32_t end = chunk.size();
+        while (i < end) {
+            if (chunk.start(i) <= local && local <= chunk.end(i)) {
+                found = i;
+                end = chunk.subtreeEnd(i);
+                ++i;
+            } else if (chunk.start(i) > local) {
+                break;
+            } else {
+                i = chunk.subtreeEnd(i);
+            }
+        }
+        if (found == SyntaxChunk::NONE) {
+            return {};
+        }
+        return {&chunk, found, piece->offset};
+    }
+} // namespace lsp
@@ -0,0 +1,224 @@
+#include "TokenList.h"
+#include <string>
+
+namespace lsp {
+
+    namespace {
+
+        // A block is closed at the first line start after it reaches this
+        // many tokens. Relexing after an edit covers about one block.
+        constexpr size_t BLOCK_TOKENS = 512;
+
+        // Windows start small for relexing, which usually stops within a
+        // few lines, and grow for long runs
+        constexpr size_t FIRST_WINDOW = 1024;
+        constexpr size_t MAX_WINDOW = 64 * 1024;
+        // A token ending this close to the window end may continue past
+        // it, so it is lexed again with the next window
+        constexpr size_t LOOKAHEAD = 4;
+
+        // Lexes `text` from `from` on, a window at a time, and calls
+        // emit(Token) with document offsets until it returns false
+        template <typename Emit>
+        void lexFrom(const Rope& text, size_t from, Emit&& emit) {
+            size_t size = text.size();
+            size_t window = FIRST_WINDOW;
+            std::string buffer;
+            std::vector<Token> tokens;
+            size_t lexed = from;
+            while (lexed < size) {
+                size_t end = std::min(size, lexed + window);
+                buffer = text.substr(lexed, end - lexed);
+                tokens.clear();
+                tokenize(buffer, tokens);
+
+                size_t keep = tokens.size();
+                if (end < size) {
+                    size_t limit = end - lexed - LOOKAHEAD;
+                    while (keep > 0 && tokens[keep - 1].end() > limit) {
+                        --keep;
+                    }
+                    if (keep == 0 && !tokens.empty()) {
+                        // A single token fills the window: try a larger one
+                        window *= 2;
+                        continue;
+                    }
+                }
+                for (size_t i = 0; i < keep; ++i) {
+                    Token token = tokens[i];
+                    token.offset += static_cast<uint32_t>(lexed);
+                    if (!emit(token)) {
+                        return;
+                    }
+                }
+                lexed = keep < tokens.size() ? lexed + tokens[keep].offset
+                                             : end;
+                if (window < MAX_WINDOW) {
+                    window *= 2;
+                }
+            }
+        }
+
+        // Collects tokens into blocks appended to a piece table
+        class BlockBuilder {
+          public:
+            BlockBuilder(std::vector<TokenList::Piece>& pieces, size_t start)
+                : pieces(pieces), start(start) {}
+
+            size_t size() const {
+                return tokens.size();
+            }
+            void add(Token token) {
+                token.offset -= static_cast<uint32_t>(start);
+                tokens.push_back(token);
+            }
+            // Adds the tokens of `block`, which starts at `offset`
+            void append(const TokenBlock& block, size_t offset) {
+                auto shift = static_cast<uint32_t>(offset - start);
+                for (Token token : block.tokens()) {
+                    token.offset += shift;
+                    tokens.push_back(token);
+                }
+            }
+            // Closes the current block at `end`, the next one's start
+            void flush(size_t end) {
+                pieces.push_back({std::make_shared<const TokenBlock>(
+                                      std::move(tokens),
+                                      static_cast<uint32_t>(end - start)),
+                                  start});
+                tokens = {};
+                start = end;
+            }
+
+          private:
+            std::vector<TokenList::Piece>& pieces;
+            std::vector<Token> tokens;
+            size_t start;
+        };
+    } // namespace
+
+    TokenList::TokenList(std::vector<Piece> pieces)
+        : pieces(std::move(pieces)) {
+        for (const Piece& piece : this->pieces) {
+            count += piece.block->tokens().size();
+        }
+    }
+
+    TokenList::Cursor::Cursor(const TokenList& list, size_t offset)
+        : list(&list), piece(0), index(0) {
+        // The block holding the offset, then the token within it
+        const std::vector<Piece>& pieces = list.pieces;
+        auto it = std::upper_bound(
+            pieces.begin(), pieces.end(), offset,
+            [](size_t value, const Piece& p) { return value < p.offset; });
+        if (it == pieces.begin()) {
+            skipExhausted();
+            return;
+        }
+        --it;
+        piece = static_cast<size_t>(it - pieces.begin());
+        std::span<const Token> tokens = it->block->tokens();
+        auto local = static_cast<uint32_t>(offset - it->offset);
+        index = static_cast<size_t>(
+            std::partition_point(tokens.begin(), tokens.end(),
+                                 [local](const Token& token) {
+                                     return token.offset < local;
+                                 }) -
+            tokens.begin());
+        skipExhausted();
+    }
+
+    void TokenList::Cursor::skipExhausted() {
+        while (piece < list->pieces.size() &&
+               index >= list->pieces[piece].block->tokens().size()) {
+            ++piece;
+            index = 0;
+        }
+    }
+
+    std::shared_ptr<const TokenList> lexTokens(const Rope& text) {
+        std::vector<TokenList::Piece> pieces;
+        BlockBuilder builder(pieces, 0);
+        lexFrom(text, 0, [&](Token token) {
+            builder.add(token);
+            if (token.kind == TokenKind::Newline &&
+                builder.size() >= BLOCK_TOKENS) {
+                builder.flush(token.end());
+            }
+            return true;
+        });
+        builder.flush(text.size());
+        return std::make_shared<const TokenList>(std::move(pieces));
+    }
+
+    std::shared_ptr<const TokenList>
+    relexTokens(const TokenList& previous, const Rope& text,
+                const EditSpan& edit) {
+        const std::vector<TokenList::Piece>& old = previous.blocks();
+        if (old.empty()) {
+            return lexTokens(text);
+        }
+
+        // The last checkpoint at or before the edit: the text before it is
+        // unchanged, and the lexer starts there without state
+        auto first = std::upper_bound(
+            old.begin(), old.end(), edit.start,
+            [](size_t value, const TokenList::Piece& p) {
+                return value < p.offset;
+            });
+        if (first != old.begin()) {
+            --first;
+        }
+        std::vector<TokenList::Piece> pieces(old.begin(), first);
+        pieces.reserve(old.size() + 1);
+
+        // Checkpoints after the edit see the same text as before, so once
+        // the new tokens reach one of them the old blocks take over
+        auto reuse = std::partition_point(
+            first, old.end(), [&](const TokenList::Piece& piece) {
+                return piece.offset <= edit.oldEnd;
+            });
+        auto shifted = [&](const TokenList::Piece& piece) {
+            return piece.offset - edit.oldEnd + edit.newEnd;
+        };
+
+        BlockBuilder builder(pieces, first->offset);
+        bool synced = false;
+        lexFrom(text, first->offset, [&](Token token) {
+            builder.add(token);
+            if (token.kind != TokenKind::Newline) {
+                return true;
+            }
+            size_t checkpoint = token.end();
+            while (reuse != old.end() && shifted(*reuse) < checkpoint) {
+                ++reuse;
+            }
+            if (reuse != old.end() && shifted(*reuse) == checkpoint) {
+                synced = true;
+                return false;
+            }
+            if (builder.size() >= BLOCK_TOKENS) {
+                builder.flush(checkpoint);
+            }
+            return true;
+        });
+
+        if (!synced) {
+            builder.flush(text.size());
+        } else {
+            // A short block takes in the one it met, so blocks don't
+            // fragment over many small edits
+            if (builder.size() < BLOCK_TOKENS / 2) {
+                builder.append(*reuse->block, shifted(*reuse));
+                builder.flush(shifted(*reuse) + reuse->block->length());
+                ++reuse;
+            } else {
+                builder.flush(shifted(*reuse));
+            }
+            for (; reuse != old.end(); ++reuse) {
+                pieces.push_back({reuse->block, shifted(*reuse)});
+            }
+        }
+        return std::make_shared<const TokenList>(std::move(pieces));
+    }
+} // namespace lsp
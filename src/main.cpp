@@ -1,8 +1,26 @@
 #include "LSPServer.h"
+#include <cstring>
+#include <iostream>
+#include <string>
 
-int main() {
-    lsp::Server server;
-    server.run();
+int main(int argc, char** argv) {
+    std::string recordPath;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            // Capture all traffic to a session trace for later replay
+            recordPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--stdio") != 0) {
+            // --stdio is what editors pass for the only transport we have
+            std::cerr << "Ignoring unknown argument " << argv[i] << std::endl;
+        }
+    }
+
+    try {
+        lsp::Server server;
+        server.run(recordPath);
+    } catch (const std::exception& e) {
+        std::cerr << "swirl_lsp: " << e.what() << std::endl;
+        return 1;
+    }
     return 0;
 }
-
@@ -0,0 +1,252 @@
+// Checks that incremental relexing and reparsing produce the same tokens,
+// nodes and errors as lexing and parsing the edited text from scratch.
+// Runs a few hand-written edits known to cross item boundaries, then
+// seeded random edits over a document of several chunks.
+//
+//   swirl_lsp_parser_test
+#include "Parser.h"
+#include "Rope.h"
+#include "SyntaxTree.h"
+#include "TokenList.h"
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+    // A tree as a flat list of node and error descriptions, in order
+    std::vector<std::string> describe(const lsp::SyntaxTree& tree) {
+        std::vector<std::string> out;
+        tree.forEachNode([&](lsp::SyntaxNode node) {
+            lsp::SyntaxNode parent = node.parent();
+            out.push_back(std::to_string(static_cast<int>(node.kind())) +
+                          " [" + std::to_string(node.start()) + "," +
+                          std::to_string(node.end()) + ") in " +
+                          (parent ? std::to_string(parent.start()) : "-"));
+        });
+        tree.forEachError([&](size_t offset, size_t length,
+                              const char* message) {
+            out.push_back("error " + std::to_string(offset) + "+" +
+                          std::to_string(length) + " " + message);
+        });
+        return out;
+    }
+
+    std::vector<std::string> describe(const lsp::TokenList& tokens) {
+        std::vector<std::string> out;
+        tokens.forEachToken([&](lsp::Token token) {
+            out.push_back(std::to_string(static_cast<int>(token.kind)) + " " +
+                          std::to_string(token.offset) + "+" +
+                          std::to_string(token.length));
+        });
+        return out;
+    }
+
+    // First line where two descriptions differ
+    std::string firstDifference(const std::vector<std::string>& a,
+                                const std::vector<std::string>& b) {
+        for (size_t i = 0; i < a.size() && i < b.size(); ++i) {
+            if (a[i] != b[i]) {
+                return a[i] + " vs " + b[i];
+            }
+        }
+        return std::to_string(a.size()) + " vs " + std::to_string(b.size()) +
+               " entries";
+    }
+
+    // A document with its tokens and tree, kept up to date incrementally
+    struct Document {
+        std::string text;
+        lsp::Rope rope;
+        std::shared_ptr<const lsp::TokenList> tokens;
+        std::shared_ptr<const lsp::SyntaxTree> tree;
+
+        explicit Document(std::string source)
+            : text(std::move(source)), rope(text),
+              tokens(lsp::lexTokens(rope)),
+              tree(lsp::parseSyntax(rope, *tokens)) {}
+
+        // Replaces [start, start + length) with `insert`, without
+        // reparsing; returns the edit in the coordinates of the new text
+        lsp::EditSpan replace(size_t start, size_t length,
+                              std::string_view insert) {
+            text.replace(start, length, insert);
+            rope = rope.replace(start, length, insert);
+            return {start, start + length, start + insert.size()};
+        }
+
+        void reparse(const lsp::EditSpan& edit) {
+            tokens = lsp::relexTokens(*tokens, rope, edit);
+            tree = lsp::reparseSyntax(*tree, rope, *tokens, edit);
+        }
+    };
+
+    int failures = 0;
+
+    // Compares the incremental state of `document` with a fresh parse
+    void check(const Document& document, const std::string& what) {
+        auto tokens = lsp::lexTokens(document.rope);
+        auto tree = lsp::parseSyntax(document.rope, *tokens);
+        std::vector<std::string> expectedTokens = describe(*tokens);
+        std::vector<std::string> actualTokens = describe(*document.tokens);
+        std::vector<std::string> expectedTree = describe(*tree);
+        std::vector<std::string> actualTree = describe(*document.tree);
+        if (actualTokens != expectedTokens) {
+            std::printf("FAIL %s: tokens differ: %s\n", what.c_str(),
+                        firstDifference(actualTokens, expectedTokens).c_str());
+            ++failures;
+        } else if (actualTree != expectedTree) {
+            std::printf("FAIL %s: trees differ: %s\n", what.c_str(),
+                        firstDifference(actualTree, expectedTree).c_str());
+            ++failures;
+        }
+    }
+
+    // Filler that spans several chunks, so edits land between reused ones
+    std::string filler(size_t items) {
+        std::string text;
+        for (size_t i = 0; i < items; ++i) {
+            std::string n = std::to_string(i);
+            text += "fn f" + n + "(a: i32) -> i32 {\n    var x = a + " + n +
+                    "\n    return x\n}\n";
+        }
+        return text;
+    }
+
+    // Text typed after an item can join it, as an else does an if
+    void testContinuations() {
+        const std::string prefix = filler(200);
+        const char* layouts[] = {
+            "if x { a() }\n",
+            "if x { a() }\n\n",
+            "if x {\n    a()\n}\n",
+            "if x { a() } elif y { b() }\n",
+        };
+        const char* inserts[] = {
+            "else {\n    b()\n}\n",
+            "elif z { c() }\n",
+            "else { b() }",
+        };
+        for (const char* layout : layouts) {
+            for (const char* insert : inserts) {
+                Document document(prefix + layout);
+                size_t at = document.text.size();
+                document.reparse(document.replace(at, 0, insert));
+                check(document, std::string("append '") + insert +
+                                    "' after '" + layout + "'");
+            }
+        }
+    }
+
+    void testRandomEdits() {
+        const char* fragments[] = {
+            "{",      "}",      "(",      ")",        "\n",     " ",
+            "x",      "/*",     "*/",     "\"",       ";",      "+",
+            ".",      ",",      "[",      "]",        "import", "elif",
+            "else",   "return", "// c\n", "fn f() {", "if a {",
+            "var a = 1\n",     "if x { a() }\n",     "else {\n    b()\n}\n",
+        };
+        constexpr size_t FRAGMENTS = std::size(fragments);
+        const std::string base = filler(400);
+        std::mt19937 rng(42);
+        for (int round = 0; round < 20; ++round) {
+            Document document(base);
+            for (int step = 0; step < 25; ++step) {
+                // Up to three changes folded into one edit, as a
+                // didChange with several content changes is
+                std::optional<lsp::EditSpan> edit;
+                int batch = 1 + static_cast<int>(rng() % 3);
+                for (int i = 0; i < batch; ++i) {
+                    size_t start = rng() % (document.text.size() + 1);
+                    size_t length = rng() % 4 == 0 ? rng() % 40 : rng() % 3;
+                    length = std::min(length, document.text.size() - start);
+                    std::string_view insert =
+                        rng() % 3 != 0 ? fragments[rng() % FRAGMENTS] : "";
+                    lsp::EditSpan change =
+                        document.replace(start, length, insert);
+                    if (edit) {
+                        edit->merge(change);
+                    } else {
+                        edit = change;
+                    }
+                }
+                document.reparse(*edit);
+                int before = failures;
+                check(document, "round " + std::to_string(round) + " step " +
+                                    std::to_string(step));
+                if (failures != before) {
+                    // Later steps would only repeat the same difference
+                    break;
+                }
+            }
+        }
+    }
+
+    // A long postfix chain, each operator wrapping everything before it
+    void testLongChains() {
+        const size_t length = 3000;
+        std::string text = "var v = a";
+        for (size_t i = 0; i < length; ++i) {
+            text += i % 3 == 0 ? ".m" : i % 3 == 1 ? "(b.c, d[e])" : "[f.g]";
+        }
+        text += " + h.i\n";
+        Document document(text);
+        size_t wrappers = 0;
+        document.tree->forEachNode([&](lsp::SyntaxNode node) {
+            lsp::SyntaxNode parent = node.parent();
+            if (parent && (node.start() < parent.start() ||
+                           node.end() > parent.end())) {
+                std::printf("FAIL long chain: node outside its parent\n");
+                ++failures;
+            }
+            lsp::NodeKind kind = node.kind();
+            if ((kind == lsp::NodeKind::Member ||
+                 kind == lsp::NodeKind::Call ||
+                 kind == lsp::NodeKind::Index) &&
+                node.start() == 8) {
+                ++wrappers;
+            }
+        });
+        if (wrappers != length) {
+            std::printf("FAIL long chain: %zu wrappers for %zu operators\n",
+                        wrappers, length);
+            ++failures;
+        }
+    }
+
+    // Nesting deep enough to overflow the stack if recursed into
+    void testDeepNesting() {
+        const size_t depth = 100000;
+        std::string text = "var v: " + std::string(depth, '[') + "int" +
+                           std::string(depth, ']') + "\nvar e = " +
+                           std::string(depth, '(') + "1" +
+                           std::string(depth, ')') + "\n";
+        Document document(text);
+        size_t errors = 0;
+        document.tree->forEachError(
+            [&](size_t, size_t, const char*) { ++errors; });
+        if (errors == 0) {
+            std::printf("FAIL deep nesting: no error reported\n");
+            ++failures;
+        }
+    }
+} // namespace
+
+int main() {
+    testContinuations();
+    testRandomEdits();
+    testLongChains();
+    testDeepNesting();
+    if (failures != 0) {
+        std::printf("%d failures\n", failures);
+        return 1;
+    }
+    std::printf("all passed\n");
+    return 0;
+}
@@ -0,0 +1,658 @@
+// Drives a swirl_lsp process over pipes like an editor would and reports
+// latency percentiles as JSON.
+//
+// Generated load: opens N synthetic files and types into them at a fixed
+// keystroke rate with incremental didChange edits, interleaving hover and
+// completion requests at the cursor.
+//
+//   swirl_lsp_loadgen --server <path> [--files N] [--file-size BYTES]
+//                     [--kps KEYSTROKES_PER_SECOND] [--duration SECONDS]
+//                     [--hover-every K] [--completion-every K]
+//                     [--switch-every K] [--save <file>]
+//                     [--record <trace>]
+//
+// --record starts the server with `--record <trace>`, so a generated run
+// can be captured as a session trace.
+//
+// Replay: sends a previously saved client stream (Content-Length framed
+// messages, as written by --save) to the server byte for byte. A session
+// trace recorded with `swirl_lsp --record` is replayed with its original
+// timing, scaled by --speed (0 sends as fast as possible), and the
+// latencies seen while recording are reported next to the replayed ones.
+//
+//   swirl_lsp_loadgen --server <path> --replay <file> [--speed X]
+#include "MessageReader.h"
+#include "SessionTrace.h"
+#include "json.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+using json = nlohmann::json;
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    struct Options {
+        std::string server;
+        std::string replay;
+        std::string save;
+        std::string record;
+        int files = 4;
+        size_t fileSize = 16 * 1024;
+        double keystrokesPerSecond = 20;
+        double duration = 10;
+        int hoverEvery = 5;
+        int completionEvery = 8;
+        int switchEvery = 50;
+        double drainTimeout = 5;
+        double speed = 1;
+    };
+
+    // Child process with its stdin and stdout connected to pipes
+    class ServerProcess {
+      public:
+        ServerProcess(const std::string& path,
+                      const std::vector<std::string>& arguments) {
+            std::vector<char*> argv{const_cast<char*>(path.c_str())};
+            for (const std::string& argument : arguments) {
+                argv.push_back(const_cast<char*>(argument.c_str()));
+            }
+            argv.push_back(nullptr);
+
+            int toServer[2], fromServer[2];
+            if (::pipe(toServer) != 0 || ::pipe(fromServer) != 0) {
+                throw std::runtime_error(std::strerror(errno));
+            }
+            pid = ::fork();
+            if (pid < 0) {
+                throw std::runtime_error(std::strerror(errno));
+            }
+            if (pid == 0) {
+                ::dup2(toServer[0], STDIN_FILENO);
+                ::dup2(fromServer[1], STDOUT_FILENO);
+                int devNull = ::open("/dev/null", O_WRONLY);
+                ::dup2(devNull, STDERR_FILENO);
+                for (int fd : {toServer[0], toServer[1], fromServer[0],
+                               fromServer[1], devNull}) {
+                    ::close(fd);
+                }
+                ::execv(path.c_str(), argv.data());
+                std::_Exit(127);
+            }
+            ::close(toServer[0]);
+            ::close(fromServer[1]);
+            input = toServer[1];
+            output = fromServer[0];
+        }
+
+        ~ServerProcess() {
+            closeInput();
+            if (output >= 0) {
+                ::close(output);
+            }
+            if (pid > 0) {
+                wait();
+            }
+        }
+
+        bool write(std::string_view data) {
+            while (!data.empty()) {
+                ssize_t n = ::write(input, data.data(), data.size());
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (n <= 0) {
+                    return false;
+                }
+                data.remove_prefix(static_cast<size_t>(n));
+            }
+            return true;
+        }
+
+        // End of input makes the server shut down
+        void closeInput() {
+            if (input >= 0) {
+                ::close(input);
+                input = -1;
+            }
+        }
+
+        int wait() {
+            int status = 0;
+            ::waitpid(pid, &status, 0);
+            pid = -1;
+            return status;
+        }
+
+        int outputFd() const {
+            return output;
+        }
+
+      private:
+        pid_t pid = -1;
+        int input = -1;
+        int output = -1;
+    };
+
+    // Matches server output against what was sent and collects latencies.
+    // Requests are matched on id; edits on the version of the first
+    // publishDiagnostics that covers them.
+    class Tracker {
+      public:
+        // Times default to now; trace analysis passes recorded ones
+        void requestSent(const json& id, const std::string& method,
+                         Clock::time_point now = Clock::now()) {
+            std::lock_guard lock(mutex);
+            requests[id.dump()] = {method, now};
+        }
+
+        void editSent(const std::string& uri, int version,
+                      const std::string& kind,
+                      Clock::time_point now = Clock::now()) {
+            std::lock_guard lock(mutex);
+            edits[uri].push_back({version, kind, now});
+        }
+
+        // Picks the requests and edits out of a client message
+        void clientMessage(const json& message,
+                           Clock::time_point now = Clock::now()) {
+            if (!message.is_object() || !message.contains("method")) {
+                return;
+            }
+            const std::string& method = message["method"];
+            if (message.contains("id")) {
+                requestSent(message["id"], method, now);
+            } else if (method == "textDocument/didOpen" ||
+                       method == "textDocument/didChange") {
+                const json& document = message["params"]["textDocument"];
+                editSent(document["uri"], document["version"],
+                         method == "textDocument/didOpen" ? "open"
+                                                          : "keystroke",
+                         now);
+            }
+        }
+
+        void received(const json& message,
+                      Clock::time_point now = Clock::now()) {
+            std::lock_guard lock(mutex);
+            if (message.contains("id") && !message.contains("method")) {
+                auto it = requests.find(message["id"].dump());
+                if (it == requests.end()) {
+                    return;
+                }
+                record(it->second.method, now - it->second.sent);
+                if (message.contains("error")) {
+                    ++errors;
+                }
+                requests.erase(it);
+                responded.notify_all();
+                return;
+            }
+
+            if (message.value("method", "") !=
+                "textDocument/publishDiagnostics") {
+                return;
+            }
+            const json& params = message["params"];
+            auto it = edits.find(params.value("uri", ""));
+            if (it == edits.end() || !params.contains("version")) {
+                return;
+            }
+            int version = params["version"];
+            auto& pending = it->second;
+            while (!pending.empty() && pending.front().version <= version) {
+                record(pending.front().kind + "ToDiagnostics",
+                       now - pending.front().sent);
+                pending.pop_front();
+            }
+            ++publishes;
+            responded.notify_all();
+        }
+
+        // Waits until every request was answered and every edit was
+        // covered by diagnostics, or the timeout passes
+        bool drain(std::chrono::duration<double> timeout) {
+            std::unique_lock lock(mutex);
+            return responded.wait_for(lock, timeout, [&] {
+                return requests.empty() &&
+                       std::all_of(edits.begin(), edits.end(), [](auto& e) {
+                           return e.second.empty();
+                       });
+            });
+        }
+
+        json report() {
+            std::lock_guard lock(mutex);
+            json latencies = json::object();
+            for (auto& [name, values] : samples) {
+                latencies[name] = summarize(values);
+            }
+            size_t unmatchedEdits = 0;
+            for (const auto& [uri, pending] : edits) {
+                unmatchedEdits += pending.size();
+            }
+            return {{"latencies", latencies},
+                    {"publishes", publishes},
+                    {"errors", errors},
+                    {"unansweredRequests", requests.size()},
+                    {"editsWithoutDiagnostics", unmatchedEdits}};
+        }
+
+      private:
+        struct SentRequest {
+            std::string method;
+            Clock::time_point sent;
+        };
+        struct SentEdit {
+            int version;
+            std::string kind;
+            Clock::time_point sent;
+        };
+
+        std::mutex mutex;
+        std::condition_variable responded;
+        std::unordered_map<std::string, SentRequest> requests;
+        std::unordered_map<std::string, std::deque<SentEdit>> edits;
+        std::map<std::string, std::vector<double>> samples; // in µs
+        size_t publishes = 0;
+        size_t errors = 0;
+
+        void record(const std::string& name, Clock::duration latency) {
+            samples[name].push_back(
+                std::chrono::duration<double, std::micro>(latency).count());
+        }
+
+        static json summarize(std::vector<double>& samples) {
+            std::sort(samples.begin(), samples.end());
+            auto at = [&](double q) {
+                size_t rank = static_cast<size_t>(
+                    std::ceil(q * static_cast<double>(samples.size())));
+                return samples[std::clamp<size_t>(rank, 1, samples.size()) -
+                               1];
+            };
+            double sum = 0;
+            for (double sample : samples) {
+                sum += sample;
+            }
+            return {{"count", samples.size()},
+                    {"meanUs", sum / samples.size()},
+                    {"p50Us", at(0.50)},
+                    {"p99Us", at(0.99)},
+                    {"p999Us", at(0.999)},
+                    {"maxUs", samples.back()}};
+        }
+    };
+
+    std::string frame(const json& message) {
+        std::string body = message.dump();
+        return "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" +
+               body;
+    }
+
+    // Reads everything the server writes until it closes stdout
+    std::thread startReader(int fd, Tracker& tracker) {
+        return std::thread([fd, &tracker] {
+            lsp::MessageReader reader(fd);
+            while (auto body = reader.next()) {
+                json message = json::parse(*body, nullptr, false);
+                if (!message.is_discarded()) {
+                    tracker.received(message);
+                }
+            }
+        });
+    }
+
+    std::string makeSource(size_t size) {
+        static const char* const BLOCK =
+            "import std.io\n"
+            "// Adds two numbers and clamps the result\n"
+            "fn add(a: i32, b: i32) -> i32 {\n"
+            "    var total = a + b * 42\n"
+            "    if total >= 10 && total != 99 {\n"
+            "        return total\n"
+            "    }\n"
+            "    return total\n"
+            "}\n"
+            "\n";
+        std::string source;
+        while (source.size() < size) {
+            source += BLOCK;
+        }
+        return source;
+    }
+
+    // What gets typed, over and over
+    constexpr std::string_view SNIPPET = "    var count = total.size() + 1\n";
+
+    struct OpenFile {
+        std::string uri;
+        int version = 1;
+        int line = 0;
+        int character = 0;
+    };
+
+    json generate(const Options& options, ServerProcess& server,
+                  Tracker& tracker) {
+        std::string saved;
+        int nextId = 1;
+        auto send = [&](const json& message) {
+            std::string bytes = frame(message);
+            if (message.contains("id")) {
+                tracker.requestSent(message["id"], message["method"]);
+            }
+            if (!options.save.empty()) {
+                saved += bytes;
+            }
+            return server.write(bytes);
+        };
+        auto request = [&](const std::string& method, json params) {
+            return send({{"jsonrpc", "2.0"},
+                         {"id", nextId++},
+                         {"method", method},
+                         {"params", std::move(params)}});
+        };
+        auto notify = [&](const std::string& method, json params) {
+            return send(
+                {{"jsonrpc", "2.0"}, {"method", method}, {"params", params}});
+        };
+
+        // Every edit is matched to a publish, so the server is asked not to
+        // skip publishes that repeat the previous diagnostics
+        request("initialize",
+                {{"processId", ::getpid()},
+                 {"capabilities", json::object()},
+                 {"initializationOptions",
+                  {{"publishUnchangedDiagnostics", true}}},
+                 {"trace", "off"}});
+        tracker.drain(std::chrono::seconds(5));
+        notify("initialized", json::object());
+
+        std::string source = makeSource(options.fileSize);
+        int lines = static_cast<int>(
+            std::count(source.begin(), source.end(), '\n'));
+        std::vector<OpenFile> files;
+        for (int i = 0; i < options.files; ++i) {
+            OpenFile file;
+            file.uri = "file:///loadgen/file" + std::to_string(i) + ".swirl";
+            file.line = lines / 2;
+            tracker.editSent(file.uri, file.version, "open");
+            notify("textDocument/didOpen", {{"textDocument",
+                                             {{"uri", file.uri},
+                                              {"languageId", "swirl"},
+                                              {"version", file.version},
+                                              {"text", source}}}});
+            files.push_back(std::move(file));
+        }
+
+        auto interval = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(1.0 / options.keystrokesPerSecond));
+        auto start = Clock::now();
+        auto end = start + std::chrono::duration_cast<Clock::duration>(
+                               std::chrono::duration<double>(options.duration));
+        size_t keystrokes = 0;
+        for (auto next = start; next < end; next += interval) {
+            std::this_thread::sleep_until(next);
+
+            OpenFile& file =
+                files[(keystrokes / options.switchEvery) % files.size()];
+            char c = SNIPPET[keystrokes % SNIPPET.size()];
+            json position = {{"line", file.line},
+                             {"character", file.character}};
+            file.version++;
+            tracker.editSent(file.uri, file.version, "keystroke");
+            bool ok = notify(
+                "textDocument/didChange",
+                {{"textDocument",
+                  {{"uri", file.uri}, {"version", file.version}}},
+                 {"contentChanges",
+                  {{{"range", {{"start", position}, {"end", position}}},
+                    {"text", std::string(1, c)}}}}});
+            if (c == '\n') {
+                file.line++;
+                file.character = 0;
+            } else {
+                file.character++;
+            }
+            ++keystrokes;
+
+            json cursor = {{"textDocument", {{"uri", file.uri}}},
+                           {"position",
+                            {{"line", file.line},
+                             {"character", std::max(0, file.character - 1)}}}};
+            if (options.hoverEvery > 0 &&
+                keystrokes % options.hoverEvery == 0) {
+                ok = ok && request("textDocument/hover", cursor);
+            }
+            if (options.completionEvery > 0 &&
+                keystrokes % options.completionEvery == 0) {
+                ok = ok && request("textDocument/completion", cursor);
+            }
+            if (!ok) {
+                std::cerr << "server closed its input" << std::endl;
+                break;
+            }
+        }
+
+        if (!options.save.empty()) {
+            std::ofstream(options.save, std::ios::binary) << saved;
+        }
+        return {{"keystrokes", keystrokes},
+                {"seconds", std::chrono::duration<double>(Clock::now() -
+                                                          start)
+                                .count()}};
+    }
+
+    // Splits a saved client stream into frames and sends them unchanged,
+    // tracking requests and edits on the way
+    json replay(const Options& options, ServerProcess& server,
+                Tracker& tracker) {
+        std::ifstream in(options.replay, std::ios::binary);
+        if (!in) {
+            throw std::runtime_error("cannot open " + options.replay);
+        }
+        std::stringstream contents;
+        contents << in.rdbuf();
+        std::string stream = contents.str();
+
+        size_t position = 0, frames = 0;
+        auto start = Clock::now();
+        while (position < stream.size()) {
+            size_t headerEnd = stream.find("\r\n\r\n", position);
+            if (headerEnd == std::string::npos) {
+                server.write(std::string_view(stream).substr(position));
+                break;
+            }
+            size_t length = 0;
+            std::string_view headers(stream.data() + position,
+                                     headerEnd - position);
+            size_t field = headers.find("Content-Length:");
+            if (field != std::string_view::npos) {
+                length = std::stoul(
+                    std::string(headers.substr(field + 15)));
+            }
+            size_t bodyStart = headerEnd + 4;
+            size_t frameEnd = std::min(stream.size(), bodyStart + length);
+
+            tracker.clientMessage(json::parse(stream.begin() + bodyStart,
+                                              stream.begin() + frameEnd,
+                                              nullptr, false));
+
+            if (!server.write(std::string_view(stream).substr(
+                    position, frameEnd - position))) {
+                break;
+            }
+            position = frameEnd;
+            ++frames;
+        }
+        return {{"frames", frames},
+                {"bytes", stream.size()},
+                {"seconds", std::chrono::duration<double>(Clock::now() -
+                                                          start)
+                                .count()}};
+    }
+
+    // Replays the inbound side of a session trace with its original
+    // pacing. The outbound side is run through a second tracker so the
+    // report can put recorded and replayed latencies side by side.
+    json replayTrace(const Options& options, ServerProcess& server,
+                     Tracker& tracker) {
+        std::vector<lsp::TraceRecord> records = lsp::loadTrace(options.replay);
+
+        Tracker recorded;
+        Clock::time_point epoch{};
+        for (const lsp::TraceRecord& record : records) {
+            auto at = epoch + std::chrono::nanoseconds(record.nanoseconds);
+            json message = json::parse(record.body, nullptr, false);
+            if (record.direction == lsp::TraceDirection::Inbound) {
+                recorded.clientMessage(message, at);
+            } else if (!message.is_discarded()) {
+                recorded.received(message, at);
+            }
+        }
+
+        size_t frames = 0;
+        auto start = Clock::now();
+        for (const lsp::TraceRecord& record : records) {
+            if (record.direction != lsp::TraceDirection::Inbound) {
+                continue;
+            }
+            if (options.speed > 0) {
+                std::this_thread::sleep_until(
+                    start + std::chrono::duration_cast<Clock::duration>(
+                                std::chrono::nanoseconds(record.nanoseconds) /
+                                options.speed));
+            }
+            tracker.clientMessage(json::parse(record.body, nullptr, false));
+            if (!server.write("Content-Length: " +
+                              std::to_string(record.body.size()) +
+                              "\r\n\r\n" + record.body)) {
+                break;
+            }
+            ++frames;
+        }
+        return {{"frames", frames},
+                {"speed", options.speed},
+                {"seconds", std::chrono::duration<double>(Clock::now() -
+                                                          start)
+                                .count()},
+                {"recorded", recorded.report()}};
+    }
+
+    std::optional<Options> parseArguments(int argc, char** argv) {
+        Options options;
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                return std::nullopt;
+            }
+            std::string value = argv[++i];
+            if (arg == "--server") {
+                options.server = value;
+            } else if (arg == "--replay") {
+                options.replay = value;
+            } else if (arg == "--record") {
+                options.record = value;
+            } else if (arg == "--save") {
+                options.save = value;
+            } else if (arg == "--files") {
+                options.files = std::max(1, std::stoi(value));
+            } else if (arg == "--file-size") {
+                options.fileSize = std::stoull(value);
+            } else if (arg == "--kps") {
+                options.keystrokesPerSecond = std::stod(value);
+            } else if (arg == "--duration") {
+                options.duration = std::stod(value);
+            } else if (arg == "--hover-every") {
+                options.hoverEvery = std::stoi(value);
+            } else if (arg == "--completion-every") {
+                options.completionEvery = std::stoi(value);
+            } else if (arg == "--switch-every") {
+                options.switchEvery = std::max(1, std::stoi(value));
+            } else if (arg == "--speed") {
+                options.speed = std::stod(value);
+            } else if (arg == "--drain-timeout") {
+                options.drainTimeout = std::stod(value);
+            } else {
+                return std::nullopt;
+            }
+        }
+        if (options.server.empty() || options.keystrokesPerSecond <= 0) {
+            return std::nullopt;
+        }
+        return options;
+    }
+} // namespace
+
+int main(int argc, char** argv) {
+    std::optional<Options> options = parseArguments(argc, argv);
+    if (!options) {
+        std::cerr << "usage: " << argv[0]
+                  << " --server <path> [--replay <file>] [--save <file>]\n"
+                     "    [--record <trace>]\n"
+                     "    [--files N] [--file-size BYTES] [--kps RATE]\n"
+                     "    [--duration SECONDS] [--hover-every K]\n"
+                     "    [--completion-every K] [--switch-every K]\n"
+                     "    [--speed X] [--drain-timeout SECONDS]"
+                  << std::endl;
+        return 2;
+    }
+    std::signal(SIGPIPE, SIG_IGN);
+
+    try {
+        std::vector<std::string> serverArguments;
+        if (!options->record.empty()) {
+            serverArguments = {"--record", options->record};
+        }
+        ServerProcess server(options->server, serverArguments);
+        Tracker tracker;
+        std::thread reader = startReader(server.outputFd(), tracker);
+
+        json run;
+        if (options->replay.empty()) {
+            run = generate(*options, server, tracker);
+        } else if (lsp::isTraceFile(options->replay)) {
+            run = replayTrace(*options, server, tracker);
+        } else {
+            run = replay(*options, server, tracker);
+        }
+        bool drained = tracker.drain(
+            std::chrono::duration<double>(options->drainTimeout));
+
+        server.closeInput();
+        reader.join();
+        int status = server.wait();
+
+        json report = tracker.report();
+        report["run"] = run;
+        report["drained"] = drained;
+        report["serverExitStatus"] =
+            WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+        std::cout << report.dump(2) << std::endl;
+        return drained ? 0 : 1;
+    } catch (const std::exception& e) {
+        std::cerr << "loadgen: " << e.what() << std::endl;
+        return 1;
+    }
+}